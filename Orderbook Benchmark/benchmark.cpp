@@ -0,0 +1,248 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <map>
+#include <string>
+#include <cstdint>
+
+#include "../Orderbook Server/price_ladder.h"
+
+// engine_benchmark.cpp
+void RunEngineBenchmark();
+
+// orderbook_benchmark.cpp
+void RunOrderbookBenchmark();
+
+using Price = std::int32_t;
+using Quantity = std::uint32_t;
+
+// Level store benchmark: the same operation stream is replayed against the dense
+// PriceLadder and the std::map layout the Orderbook used before, so the numbers only
+// differ by how levels are stored and found.
+
+struct Level
+{
+    Quantity quantity_{ };
+};
+
+enum class LevelOp : std::uint8_t
+{
+    Add,     // order joins a level (creates it if needed)
+    Fill,    // aggressor takes quantity from the best level
+    Cancel,  // order leaves a level somewhere in the book
+};
+
+struct Operation
+{
+    LevelOp op_;
+    bool buy_;
+    Price price_;
+    Quantity quantity_;
+};
+
+// tight-spread symbol: prices sit a few ticks either side of a slowly drifting mid
+std::vector<Operation> MakeTightSpreadWorkload(std::size_t count, int halfWidth, unsigned seed)
+{
+    std::mt19937 rng{ seed };
+    std::vector<Operation> ops;
+    ops.reserve(count);
+
+    Price mid = 10'000;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        if (rng() % 1000 == 0)
+            mid += static_cast<int>(rng() % 3) - 1;
+
+        const bool buy = rng() % 2 == 0;
+        const Price offset = 1 + static_cast<Price>(rng() % halfWidth);
+        const Price price = buy ? mid - offset : mid + offset;
+        const Quantity quantity = 1 + rng() % 100;
+
+        const auto roll = rng() % 10;
+        const auto op = roll < 5 ? LevelOp::Add : roll < 8 ? LevelOp::Cancel : LevelOp::Fill;
+        ops.push_back(Operation{ op, buy, price, quantity });
+    }
+
+    return ops;
+}
+
+// sparse book: a handful of levels scattered over a wide band, swept by large aggressors
+// after every few adds, so the best level keeps jumping across long runs of empty slots
+std::vector<Operation> MakeSparseSweepWorkload(std::size_t count, int halfWidth, unsigned seed)
+{
+    std::mt19937 rng{ seed };
+    std::vector<Operation> ops;
+    ops.reserve(count);
+
+    constexpr Price mid = 10'000'000;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        const bool buy = rng() % 2 == 0;
+        const Price offset = 1 + static_cast<Price>(rng() % halfWidth);
+        const Price price = buy ? mid - offset : mid + offset;
+
+        if (rng() % 4 == 0)
+            ops.push_back(Operation{ LevelOp::Fill, buy, price, 1 + static_cast<Quantity>(rng() % 500) });
+        else
+            ops.push_back(Operation{ LevelOp::Add, buy, price, 1 + static_cast<Quantity>(rng() % 100) });
+    }
+
+    return ops;
+}
+
+// thin wrappers giving both stores the operations the Orderbook needs
+template <typename Compare>
+struct MapStore
+{
+    std::map<Price, Level, Compare> levels_;
+
+    Level& Insert(Price price) { return levels_[price]; }
+    Level* Find(Price price) { auto it = levels_.find(price); return it == levels_.end() ? nullptr : &it->second; }
+    void Erase(Price price) { levels_.erase(price); }
+    bool Empty() const { return levels_.empty(); }
+    Price BestPrice() const { return levels_.begin()->first; }
+    Level& Best() { return levels_.begin()->second; }
+};
+
+template <typename Compare>
+struct LadderStore
+{
+    PriceLadder<Price, Level, Compare> levels_;
+
+    Level& Insert(Price price) { return levels_.Insert(price); }
+    Level* Find(Price price) { return levels_.Find(price); }
+    void Erase(Price price) { levels_.Erase(price); }
+    bool Empty() const { return levels_.Empty(); }
+    Price BestPrice() const { return levels_.BestPrice(); }
+    Level& Best() { return levels_.Best(); }
+};
+
+template <typename Store>
+void Take(Store& store, Price price, Quantity quantity, std::uint64_t& checksum)
+{
+    auto* level = store.Find(price);
+    if (level == nullptr)
+        return;
+
+    const auto taken = std::min(level->quantity_, quantity);
+    level->quantity_ -= taken;
+    checksum += taken;
+    if (level->quantity_ == 0)
+        store.Erase(price);
+}
+
+template <typename BidStore, typename AskStore>
+std::uint64_t Run(const std::vector<Operation>& ops)
+{
+    BidStore bids;
+    AskStore asks;
+    std::uint64_t checksum = 0;
+
+    for (const auto& op : ops)
+    {
+        switch (op.op_)
+        {
+        case LevelOp::Add:
+            if (op.buy_)
+                bids.Insert(op.price_).quantity_ += op.quantity_;
+            else
+                asks.Insert(op.price_).quantity_ += op.quantity_;
+            break;
+
+        case LevelOp::Cancel:
+            if (op.buy_)
+                Take(bids, op.price_, op.quantity_, checksum);
+            else
+                Take(asks, op.price_, op.quantity_, checksum);
+            break;
+
+        case LevelOp::Fill:
+            // a buy aggressor sweeps asks from the best price until it is done
+            {
+                Quantity remaining = op.quantity_;
+                while (remaining > 0)
+                {
+                    if (op.buy_ ? asks.Empty() : bids.Empty())
+                        break;
+
+                    const Price best = op.buy_ ? asks.BestPrice() : bids.BestPrice();
+                    const Quantity available = op.buy_ ? asks.Best().quantity_ : bids.Best().quantity_;
+                    const Quantity taken = std::min(available, remaining);
+                    remaining -= taken;
+                    checksum += static_cast<std::uint64_t>(best) * taken;
+
+                    if (op.buy_)
+                        Take(asks, best, taken, checksum);
+                    else
+                        Take(bids, best, taken, checksum);
+                }
+            }
+            break;
+        }
+    }
+
+    return checksum;
+}
+
+template <typename BidStore, typename AskStore>
+void Report(const std::string& name, const std::vector<Operation>& ops, int repetitions)
+{
+    std::uint64_t checksum = 0;
+    auto best = std::chrono::nanoseconds::max();
+
+    for (int i = 0; i < repetitions; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        checksum = Run<BidStore, AskStore>(ops);
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed));
+    }
+
+    std::cout << std::left << std::setw(12) << name
+        << std::right << std::setw(10) << std::fixed << std::setprecision(2)
+        << static_cast<double>(best.count()) / ops.size() << " ns/op"
+        << "  (checksum " << checksum << ")" << std::endl;
+}
+
+void RunLevelStoreBenchmark()
+{
+    constexpr std::size_t operations = 2'000'000;
+    constexpr int repetitions = 5;
+
+    for (int halfWidth : { 2, 5, 20 })
+    {
+        const auto ops = MakeTightSpreadWorkload(operations, halfWidth, 42);
+        std::cout << "tight spread, +/-" << halfWidth << " ticks around mid, " << operations << " level ops" << std::endl;
+
+        Report<MapStore<std::greater<Price>>, MapStore<std::less<Price>>>("std::map", ops, repetitions);
+        Report<LadderStore<std::greater<Price>>, LadderStore<std::less<Price>>>("PriceLadder", ops, repetitions);
+        std::cout << std::endl;
+    }
+
+    for (int halfWidth : { 1'000, 50'000 })
+    {
+        const auto ops = MakeSparseSweepWorkload(operations, halfWidth, 7);
+        std::cout << "sparse sweeps, +/-" << halfWidth << " ticks around mid, " << operations << " level ops" << std::endl;
+
+        Report<MapStore<std::greater<Price>>, MapStore<std::less<Price>>>("std::map", ops, repetitions);
+        Report<LadderStore<std::greater<Price>>, LadderStore<std::less<Price>>>("PriceLadder", ops, repetitions);
+        std::cout << std::endl;
+    }
+}
+
+// benchmark [levels|orderbook|engine] runs one suite, no argument runs all of them
+int main(int argc, char* argv[])
+{
+    const std::string suite = argc > 1 ? argv[1] : "";
+
+    if (suite.empty() || suite == "levels")
+        RunLevelStoreBenchmark();
+    if (suite.empty() || suite == "orderbook")
+        RunOrderbookBenchmark();
+    if (suite.empty() || suite == "engine")
+        RunEngineBenchmark();
+
+    return 0;
+}
@@ -0,0 +1,250 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <thread>
+#include <string>
+#include <cstdint>
+
+#include "../Orderbook Server/matching_engine.h"
+#include "../Orderbook Server/thread_safe_orderbook.h"
+
+// Engine benchmark: session threads drive one book either through ThreadSafeOrderbook, the mutex
+// adapter (every session locks the book itself), or through the single-writer MatchingEngine (sessions
+// only touch rings). Both see the same per-session command streams.
+
+namespace
+{
+    struct SessionCommand
+    {
+        bool cancel_;
+        Order order_;
+    };
+
+    // resting GTC orders a few ticks around a fixed mid, a third of which get cancelled again
+    std::vector<SessionCommand> MakeSessionWorkload(SessionId session, std::size_t count)
+    {
+        std::mt19937 rng{ 1000 + session };
+        std::vector<SessionCommand> commands;
+        commands.reserve(count);
+
+        std::vector<OrderID> live;
+        OrderID next = (static_cast<OrderID>(session) << 40) + 1;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (!live.empty() && rng() % 3 == 0)
+            {
+                const auto pick = rng() % live.size();
+                commands.push_back(SessionCommand{ true, Order{ OrderType::GoodTillCancel, live[pick], Side::Buy, 0, 0 } });
+                live[pick] = live.back();
+                live.pop_back();
+                continue;
+            }
+
+            const bool buy = rng() % 2 == 0;
+            const Price price = 10'000 + (buy ? -1 : 1) * static_cast<Price>(rng() % 8) + (rng() % 4 == 0 ? (buy ? 4 : -4) : 0);
+            commands.push_back(SessionCommand{ false, Order{ OrderType::GoodTillCancel, next, buy ? Side::Buy : Side::Sell, price, static_cast<Quantity>(1 + rng() % 50) } });
+            live.push_back(next++);
+        }
+
+        return commands;
+    }
+
+    // the book on its own, no threads: what every command costs inside the matching path
+    std::uint64_t RunDirect(const std::vector<std::vector<SessionCommand>>& workloads)
+    {
+        Orderbook book;
+        std::uint64_t trades = 0;
+        auto sink = [&trades](const Trade&) { ++trades; };
+
+        for (const auto& workload : workloads)
+        {
+            for (const auto& command : workload)
+            {
+                if (command.cancel_)
+                    book.CancelOrder(command.order_.GetOrderID());
+                else
+                    book.AddOrder(command.order_, sink);
+            }
+        }
+
+        return trades;
+    }
+
+    // an opening book: both sides pile up over the same wide band, so most of the orders cross
+    std::vector<SessionCommand> MakeOpeningWorkload(std::size_t count)
+    {
+        std::mt19937 rng{ 7 };
+        std::vector<SessionCommand> commands;
+        commands.reserve(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const bool buy = rng() % 2 == 0;
+            const Price price = 10'000 + static_cast<Price>(rng() % 200) - 100;
+            commands.push_back(SessionCommand{ false, Order{ OrderType::GoodTillCancel, i + 1, buy ? Side::Buy : Side::Sell, price, static_cast<Quantity>(1 + rng() % 50) } });
+        }
+
+        return commands;
+    }
+
+    // the opening orders matched one by one as they arrive
+    std::uint64_t RunContinuousOpen(const std::vector<std::vector<SessionCommand>>& workloads)
+    {
+        Orderbook book;
+        std::uint64_t trades = 0;
+        for (const auto& command : workloads.front())
+            book.AddOrder(command.order_, [&trades](const Trade&) { ++trades; });
+        return trades;
+    }
+
+    // the same orders collected in a call phase and uncrossed once
+    std::uint64_t RunAuctionOpen(const std::vector<std::vector<SessionCommand>>& workloads)
+    {
+        Orderbook book;
+        std::uint64_t trades = 0;
+        book.StartAuction();
+        for (const auto& command : workloads.front())
+            book.AddOrder(command.order_, [&trades](const Trade&) { ++trades; });
+        book.Uncross([&trades](const Trade&) { ++trades; });
+        return trades;
+    }
+
+    std::uint64_t RunMutex(const std::vector<std::vector<SessionCommand>>& workloads)
+    {
+        ThreadSafeOrderbook book;
+        std::vector<std::uint64_t> trades(workloads.size());
+        std::vector<std::thread> sessions;
+
+        for (std::size_t session = 0; session < workloads.size(); ++session)
+        {
+            sessions.emplace_back([&, session]
+                {
+                    std::uint64_t count = 0;
+                    for (const auto& command : workloads[session])
+                    {
+                        if (command.cancel_)
+                            book.CancelOrder(command.order_.GetOrderID());
+                        else
+                            book.AddOrder(command.order_, [&count](const Trade&) { ++count; });
+                    }
+                    trades[session] = count;
+                });
+        }
+
+        for (auto& thread : sessions)
+            thread.join();
+
+        std::uint64_t total = 0;
+        for (auto count : trades)
+            total += count;
+        return total;
+    }
+
+    std::uint64_t RunEngine(const std::vector<std::vector<SessionCommand>>& workloads)
+    {
+        MatchingEngine engine{ workloads.size(), 0 };
+        std::vector<std::uint64_t> trades(workloads.size());
+        std::vector<std::thread> sessions;
+
+        for (std::size_t session = 0; session < workloads.size(); ++session)
+        {
+            sessions.emplace_back([&, session]
+                {
+                    const auto id = static_cast<SessionId>(session);
+                    std::uint64_t count = 0;
+                    std::size_t done = 0;
+                    EngineResult result;
+
+                    auto drain = [&]
+                        {
+                            while (engine.Poll(id, result))
+                            {
+                                if (result.type_ == EngineResult::Type::Trade)
+                                    ++count;
+                                else
+                                    ++done;
+                            }
+                        };
+
+                    for (const auto& command : workloads[session])
+                    {
+                        const auto request = command.cancel_
+                            ? EngineCommand::Cancel(id, command.order_.GetOrderID())
+                            : EngineCommand::Add(id, command.order_);
+
+                        // keep our own result ring moving while the ingress ring is full
+                        while (!engine.Submit(request))
+                            drain();
+                    }
+
+                    while (done < workloads[session].size())
+                    {
+                        drain();
+                        std::this_thread::yield();
+                    }
+
+                    trades[session] = count;
+                });
+        }
+
+        for (auto& thread : sessions)
+            thread.join();
+
+        std::uint64_t total = 0;
+        for (auto count : trades)
+            total += count;
+        return total;
+    }
+
+    template <typename Runner>
+    void Report(const std::string& name, const std::vector<std::vector<SessionCommand>>& workloads, std::size_t operations, Runner runner)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const auto trades = runner(workloads);
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << std::left << std::setw(16) << name
+            << std::right << std::setw(10) << std::fixed << std::setprecision(2)
+            << operations / elapsed / 1e6 << " Mops/s"
+            << "  (" << trades << " trades)" << std::endl;
+    }
+}
+
+void RunEngineBenchmark()
+{
+    constexpr std::size_t operations = 1'000'000;
+
+    {
+        const std::vector<std::vector<SessionCommand>> workloads{ MakeSessionWorkload(0, operations) };
+        std::cout << "single thread, " << operations << " commands" << std::endl;
+        for (int repetition = 0; repetition < 3; ++repetition)
+            Report("Orderbook", workloads, operations, RunDirect);
+        std::cout << std::endl;
+    }
+
+    {
+        constexpr std::size_t openingOrders = 200'000;
+        const std::vector<std::vector<SessionCommand>> workloads{ MakeOpeningWorkload(openingOrders) };
+        std::cout << "opening, " << openingOrders << " orders over 200 ticks" << std::endl;
+        for (int repetition = 0; repetition < 3; ++repetition)
+        {
+            Report("continuous", workloads, openingOrders, RunContinuousOpen);
+            Report("auction", workloads, openingOrders, RunAuctionOpen);
+        }
+        std::cout << std::endl;
+    }
+
+    for (std::size_t sessionCount : { 1, 4, 16, 64 })
+    {
+        std::vector<std::vector<SessionCommand>> workloads;
+        for (std::size_t session = 0; session < sessionCount; ++session)
+            workloads.push_back(MakeSessionWorkload(static_cast<SessionId>(session), operations / sessionCount));
+
+        std::cout << sessionCount << " sessions, " << operations << " commands" << std::endl;
+        Report("mutex adapter", workloads, operations, RunMutex);
+        Report("MatchingEngine", workloads, operations, RunEngine);
+        std::cout << std::endl;
+    }
+}
@@ -0,0 +1,424 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <string>
+#include <new>
+#include <cstdint>
+#include <cstdlib>
+
+#include "../Orderbook Server/orderbook.cpp"
+
+// Orderbook microbenchmarks: one hot path at a time against a book of a given shape, depth
+// levels per side and a number of orders on every level. Each case runs in batches. A batch
+// prepares its commands, times only the calls into the book, then puts the book back into its
+// original shape untimed, so every batch sees the same book. Reported per operation are the
+// mean time and the number of heap allocations made inside the timed calls.
+
+namespace
+{
+    // counts operator new calls on this thread; the engine benchmark allocates from other threads
+    thread_local std::uint64_t allocationCount = 0;
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocationCount;
+    if (void* memory = std::malloc(size == 0 ? 1 : size))
+        return memory;
+    throw std::bad_alloc{ };
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr Price Mid = 10'000;
+    constexpr Quantity OrderQuantity = 100;
+
+    // the book under test plus a mirror of every level's queue in time priority, so a case can
+    // pick the order at the front, middle or back of a level without asking the book
+    class BookFixture
+    {
+    public:
+        BookFixture(std::size_t depth, std::size_t ordersPerLevel)
+            : depth_{ depth }
+            , ordersPerLevel_{ ordersPerLevel }
+        {
+            for (auto side : { Side::Buy, Side::Sell })
+            {
+                auto& queues = Queues(side);
+                queues.resize(depth);
+                for (std::size_t level = 0; level < depth; ++level)
+                {
+                    for (std::size_t count = 0; count < ordersPerLevel; ++count)
+                    {
+                        const auto orderID = NextID();
+                        book_.AddOrder(Order{ OrderType::GoodTillCancel, orderID, side, LevelPrice(side, level), OrderQuantity }, sink_);
+                        queues[level].push_back(orderID);
+                    }
+                }
+            }
+        }
+
+        Orderbook& Book() { return book_; }
+        std::size_t Depth() const { return depth_; }
+        std::size_t OrdersPerLevel() const { return ordersPerLevel_; }
+        OrderID NextID() { return nextID_++; }
+
+        // counts fills, so no trade is optimized away
+        struct TradeCounter
+        {
+            std::uint64_t* trades_;
+            void operator()(const Trade&) const { ++*trades_; }
+        };
+
+        TradeCounter& Sink() { return sink_; }
+
+        // level 0 is the best level; levels are one tick apart and the sides never cross
+        static Price LevelPrice(Side side, std::size_t level)
+        {
+            const auto offset = static_cast<Price>(level) + 1;
+            return side == Side::Buy ? Mid - offset : Mid + offset;
+        }
+
+        std::deque<OrderID>& Queue(Side side, std::size_t level) { return Queues(side)[level]; }
+
+        // moves the order at position in level's queue to the back of that level, as a fresh GoodTillCancel of the
+        // original size, wherever a case left it
+        void Requeue(Side side, std::size_t level, std::size_t position)
+        {
+            auto& queue = Queue(side, level);
+            const auto orderID = queue[position];
+            queue.erase(queue.begin() + static_cast<std::ptrdiff_t>(position));
+            queue.push_back(orderID);
+
+            book_.CancelOrder(orderID);
+            book_.AddOrder(Order{ OrderType::GoodTillCancel, orderID, side, LevelPrice(side, level), OrderQuantity }, sink_);
+        }
+
+    private:
+        std::vector<std::deque<OrderID>>& Queues(Side side) { return side == Side::Buy ? bids_ : asks_; }
+
+        std::size_t depth_;
+        std::size_t ordersPerLevel_;
+        Orderbook book_;
+        std::vector<std::deque<OrderID>> bids_;
+        std::vector<std::deque<OrderID>> asks_;
+        OrderID nextID_{ 1 };
+        std::uint64_t trades_{ 0 };
+        TradeCounter sink_{ &trades_ };
+    };
+
+    class Stopwatch
+    {
+    public:
+        // times work, which makes operations calls into the book
+        template <typename Work>
+        void Time(std::size_t operations, Work&& work)
+        {
+            const auto allocations = allocationCount;
+            const auto start = Clock::now();
+            work();
+            elapsed_ += Clock::now() - start;
+            allocations_ += allocationCount - allocations;
+            operations_ += operations;
+        }
+
+        std::size_t Operations() const { return operations_; }
+        double NanosecondsPerOperation() const { return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed_).count()) / operations_; }
+        double AllocationsPerOperation() const { return static_cast<double>(allocations_) / operations_; }
+
+    private:
+        Clock::duration elapsed_{ };
+        std::uint64_t allocations_{ 0 };
+        std::size_t operations_{ 0 };
+    };
+
+    // a GoodTillCancel order joining the back of an existing level without crossing
+    void AddResting(BookFixture& fixture, Stopwatch& stopwatch)
+    {
+        std::vector<Order> orders;
+        for (std::size_t index = 0; index < 1'000; ++index)
+        {
+            const auto side = index % 2 == 0 ? Side::Buy : Side::Sell;
+            const auto level = (index / 2) % fixture.Depth();
+            orders.push_back(Order{ OrderType::GoodTillCancel, fixture.NextID(), side, BookFixture::LevelPrice(side, level), OrderQuantity });
+        }
+
+        auto& book = fixture.Book();
+        auto& sink = fixture.Sink();
+        stopwatch.Time(orders.size(), [&]
+            {
+                for (const auto& order : orders)
+                    book.AddOrder(order, sink);
+            });
+
+        for (const auto& order : orders)
+            book.CancelOrder(order.GetOrderID());
+    }
+
+    // a GoodTillCancel order that fills exactly the order at the front of the opposite side
+    void AddCrossing(BookFixture& fixture, Stopwatch& stopwatch)
+    {
+        struct Hit
+        {
+            Side side_;
+            std::size_t level_;
+        };
+
+        const auto perSide = std::min<std::size_t>(500, fixture.Depth() * fixture.OrdersPerLevel());
+        std::vector<Order> orders;
+        std::vector<Hit> hits;
+        for (auto resting : { Side::Sell, Side::Buy })
+        {
+            for (std::size_t index = 0; index < perSide; ++index)
+            {
+                const auto level = index / fixture.OrdersPerLevel();
+                const auto aggressor = resting == Side::Sell ? Side::Buy : Side::Sell;
+                orders.push_back(Order{ OrderType::GoodTillCancel, fixture.NextID(), aggressor, BookFixture::LevelPrice(resting, level), OrderQuantity });
+                hits.push_back(Hit{ resting, level });
+            }
+        }
+
+        auto& book = fixture.Book();
+        auto& sink = fixture.Sink();
+        stopwatch.Time(orders.size(), [&]
+            {
+                for (const auto& order : orders)
+                    book.AddOrder(order, sink);
+            });
+
+        // every filled order comes back at the end of its level, in the order it was taken
+        for (const auto& hit : hits)
+            fixture.Requeue(hit.side_, hit.level_, 0);
+    }
+
+    // one order per level, at the given position in the level's queue
+    enum class QueuePosition
+    {
+        Front,
+        Middle,
+        Back,
+    };
+
+    std::size_t PositionIndex(QueuePosition position, std::size_t size)
+    {
+        switch (position)
+        {
+        case QueuePosition::Front: return 0;
+        case QueuePosition::Middle: return size / 2;
+        default: return size - 1;
+        }
+    }
+
+    template <QueuePosition Position>
+    void Cancel(BookFixture& fixture, Stopwatch& stopwatch)
+    {
+        std::vector<OrderID> orderIDs;
+        std::vector<std::size_t> positions;
+        for (auto side : { Side::Buy, Side::Sell })
+        {
+            for (std::size_t level = 0; level < fixture.Depth(); ++level)
+            {
+                const auto& queue = fixture.Queue(side, level);
+                positions.push_back(PositionIndex(Position, queue.size()));
+                orderIDs.push_back(queue[positions.back()]);
+            }
+        }
+
+        auto& book = fixture.Book();
+        stopwatch.Time(orderIDs.size(), [&]
+            {
+                for (auto orderID : orderIDs)
+                    book.CancelOrder(orderID);
+            });
+
+        std::size_t index = 0;
+        for (auto side : { Side::Buy, Side::Sell })
+        {
+            for (std::size_t level = 0; level < fixture.Depth(); ++level)
+                fixture.Requeue(side, level, positions[index++]);
+        }
+    }
+
+    // the order at the front of every level modified, either to half its size in place or to the next level
+    template <bool Reprice>
+    void Modify(BookFixture& fixture, Stopwatch& stopwatch)
+    {
+        std::vector<OrderModify> modifies;
+        for (auto side : { Side::Buy, Side::Sell })
+        {
+            for (std::size_t level = 0; level < fixture.Depth(); ++level)
+            {
+                const auto orderID = fixture.Queue(side, level).front();
+                if (Reprice)
+                    modifies.push_back(OrderModify{ orderID, side, BookFixture::LevelPrice(side, (level + 1) % fixture.Depth()), OrderQuantity });
+                else
+                    modifies.push_back(OrderModify{ orderID, side, BookFixture::LevelPrice(side, level), OrderQuantity / 2 });
+            }
+        }
+
+        auto& book = fixture.Book();
+        auto& sink = fixture.Sink();
+        stopwatch.Time(modifies.size(), [&]
+            {
+                for (const auto& modify : modifies)
+                    book.MatchOrder(modify, sink);
+            });
+
+        for (auto side : { Side::Buy, Side::Sell })
+        {
+            for (std::size_t level = 0; level < fixture.Depth(); ++level)
+                fixture.Requeue(side, level, 0);
+        }
+    }
+
+    // FillAndKill orders that each take a tenth of the levels on the other side, until the side is (nearly) empty
+    void Sweep(BookFixture& fixture, Stopwatch& stopwatch)
+    {
+        const auto width = std::max<std::size_t>(1, fixture.Depth() / 10);
+        const auto swept = fixture.Depth() / width * width;
+        std::vector<Order> orders;
+        for (auto resting : { Side::Sell, Side::Buy })
+        {
+            for (std::size_t level = width - 1; level < swept; level += width)
+            {
+                const auto aggressor = resting == Side::Sell ? Side::Buy : Side::Sell;
+                const auto quantity = static_cast<Quantity>(width * fixture.OrdersPerLevel() * OrderQuantity);
+                orders.push_back(Order{ OrderType::FillandKill, fixture.NextID(), aggressor, BookFixture::LevelPrice(resting, level), quantity });
+            }
+        }
+
+        auto& book = fixture.Book();
+        auto& sink = fixture.Sink();
+        stopwatch.Time(orders.size(), [&]
+            {
+                for (const auto& order : orders)
+                    book.AddOrder(order, sink);
+            });
+
+        // re-adding every queue in its own order rebuilds the book exactly
+        for (auto side : { Side::Buy, Side::Sell })
+        {
+            for (std::size_t level = 0; level < swept; ++level)
+            {
+                for (auto orderID : fixture.Queue(side, level))
+                    book.AddOrder(Order{ OrderType::GoodTillCancel, orderID, side, BookFixture::LevelPrice(side, level), OrderQuantity }, sink);
+            }
+        }
+    }
+
+    void GetOrderInfos(BookFixture& fixture, Stopwatch& stopwatch)
+    {
+        constexpr std::size_t calls = 100;
+        auto& book = fixture.Book();
+        std::size_t levels = 0;
+        stopwatch.Time(calls, [&]
+            {
+                for (std::size_t call = 0; call < calls; ++call)
+                    levels += book.GetOrderInfos().GetBids().size();
+            });
+
+        if (levels != calls * fixture.Depth())
+            std::cerr << "GetOrderInfos saw " << levels << " levels" << std::endl;
+    }
+
+    // runs batches until at least minimumOperations calls were timed, after one untimed warm-up batch
+    template <typename Batch>
+    void Report(const std::string& name, BookFixture& fixture, std::size_t minimumOperations, Batch batch)
+    {
+        Stopwatch warmUp;
+        batch(fixture, warmUp);
+
+        Stopwatch stopwatch;
+        while (stopwatch.Operations() < minimumOperations)
+            batch(fixture, stopwatch);
+
+        std::cout << std::left << std::setw(18) << name
+            << std::right << std::setw(12) << std::fixed << std::setprecision(1) << stopwatch.NanosecondsPerOperation() << " ns/op"
+            << std::setw(10) << std::setprecision(2) << stopwatch.AllocationsPerOperation() << " allocs/op" << std::endl;
+
+        const auto expected = 2 * fixture.Depth() * fixture.OrdersPerLevel();
+        if (fixture.Book().Size() != expected)
+            std::cerr << name << " left " << fixture.Book().Size() << " orders in the book instead of " << expected << std::endl;
+    }
+
+    // session close: orders GoodForDay orders rest over depth levels per side, all with the same expiry, and one
+    // ExpireOrders call takes them all out. Building the book is untimed; the best of repetitions is reported
+    void ReportSessionClose(std::size_t orders, std::size_t depth, int repetitions)
+    {
+        constexpr Timestamp close = 1'000'000;
+        Clock::duration best = Clock::duration::max();
+        std::uint64_t allocations = 0;
+
+        for (int repetition = 0; repetition < repetitions; ++repetition)
+        {
+            Orderbook book{ 1, orders };
+            for (std::size_t index = 0; index < orders; ++index)
+            {
+                const auto side = index % 2 == 0 ? Side::Buy : Side::Sell;
+                const auto level = index / 2 % depth;
+                book.AddOrder(Order{ OrderType::GoodForDay, index + 1, side, BookFixture::LevelPrice(side, level), OrderQuantity, close });
+            }
+
+            const auto before = allocationCount;
+            const auto start = Clock::now();
+            const auto expired = book.ExpireOrders(close);
+            best = std::min(best, Clock::now() - start);
+            allocations = allocationCount - before;
+
+            if (expired != orders || book.Size() != 0)
+                std::cerr << "session close expired " << expired << " of " << orders << " orders" << std::endl;
+        }
+
+        const auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(best).count();
+        std::cout << std::left << std::setw(18) << "session close"
+            << std::right << std::setw(12) << std::fixed << std::setprecision(1) << static_cast<double>(nanoseconds) / orders << " ns/order"
+            << std::setw(10) << std::setprecision(2) << static_cast<double>(nanoseconds) / 1e6 << " ms total"
+            << std::setw(10) << allocations << " allocs" << std::endl;
+    }
+}
+
+void RunOrderbookBenchmark()
+{
+    constexpr std::size_t operations = 200'000;
+
+    for (std::size_t depth : { 10, 100, 1'000 })
+    {
+        for (std::size_t ordersPerLevel : { 1, 10, 100 })
+        {
+            BookFixture fixture{ depth, ordersPerLevel };
+            std::cout << "Orderbook, " << depth << " levels per side, " << ordersPerLevel << " orders per level" << std::endl;
+
+            Report("add resting", fixture, operations, AddResting);
+            Report("add crossing", fixture, operations, AddCrossing);
+            Report("cancel front", fixture, operations, Cancel<QueuePosition::Front>);
+            Report("cancel middle", fixture, operations, Cancel<QueuePosition::Middle>);
+            Report("cancel back", fixture, operations, Cancel<QueuePosition::Back>);
+            Report("modify in place", fixture, operations, Modify<false>);
+            Report("modify reprice", fixture, operations, Modify<true>);
+            Report("sweep 10% levels", fixture, 2'000, Sweep);
+            Report("GetOrderInfos", fixture, 100'000 / depth, GetOrderInfos);
+            std::cout << std::endl;
+        }
+    }
+
+    for (std::size_t orders : { 50'000, 500'000 })
+    {
+        std::cout << "Expiry, " << orders << " GoodForDay orders over 1000 levels per side" << std::endl;
+        ReportSessionClose(orders, 1'000, 5);
+        std::cout << std::endl;
+    }
+}
@@ -22,7 +22,7 @@ constexpr size_t MAX_BUFFER_SIZE = 4096;
 
 class TcpClient {
 public:
-    TcpClient() : serverSocket_(INVALID_SOCKET), connected_(false), running_(false), nextOrderId_(1) {}
+    TcpClient() : serverSocket_(INVALID_SOCKET), connected_(false), running_(false), nextOrderId_(1), symbolId_(0) {}
 
     ~TcpClient() {
         disconnect();
@@ -192,7 +192,7 @@ public:
     }
 
     // Send an add order request
-    void sendAddOrderRequest(OrderType orderType, Side side, uint32_t price, uint32_t quantity) {
+    void sendAddOrderRequest(OrderType orderType, Side side, uint32_t price, uint32_t quantity, uint64_t expiryTime = 0, uint32_t displayQuantity = 0, uint32_t stopPrice = 0) {
         if (!connected_) {
             std::cerr << "Not connected to server" << std::endl;
             return;
@@ -203,11 +203,15 @@ public:
         request.header.type = MessageType::REQ_ADD_ORDER;
         request.header.length = sizeof(AddOrderRequest);
         request.header.sequence = 0;
+        request.symbolId = symbolId_;
         request.orderType = orderType;
         request.side = side;
         request.price = price;
         request.quantity = quantity;
         request.clientOrderId = nextOrderId_++;
+        request.expiryTime = expiryTime;
+        request.displayQuantity = displayQuantity;
+        request.stopPrice = stopPrice;
 
         // Convert to network byte order
         request.toNetworkOrder();
@@ -230,6 +234,7 @@ public:
         request.header.type = MessageType::REQ_CANCEL_ORDER;
         request.header.length = sizeof(CancelOrderRequest);
         request.header.sequence = 0;
+        request.symbolId = symbolId_;
         request.orderId = orderId;
 
         // Convert to network byte order
@@ -253,6 +258,7 @@ public:
         request.header.type = MessageType::REQ_MODIFY_ORDER;
         request.header.length = sizeof(ModifyOrderRequest);
         request.header.sequence = 0;
+        request.symbolId = symbolId_;
         request.orderId = orderId;
         request.side = side;
         request.price = price;
@@ -275,10 +281,11 @@ public:
         }
 
         // Create request
-        MessageHeader request;
-        request.type = MessageType::REQ_ORDERBOOK_STATUS;
-        request.length = sizeof(MessageHeader);
-        request.sequence = 0;
+        OrderbookStatusRequest request;
+        request.header.type = MessageType::REQ_ORDERBOOK_STATUS;
+        request.header.length = sizeof(OrderbookStatusRequest);
+        request.header.sequence = 0;
+        request.symbolId = symbolId_;
 
         // Convert to network byte order
         request.toNetworkOrder();
@@ -294,6 +301,15 @@ public:
         return connected_;
     }
 
+    // Select the instrument that following order and book commands apply to
+    void setSymbol(uint16_t symbolId) {
+        symbolId_ = symbolId;
+    }
+
+    uint16_t getSymbol() const {
+        return symbolId_;
+    }
+
 private:
     // Thread function to receive messages from server
     void receiverFunction() {
@@ -451,7 +467,7 @@ private:
         OrderbookStatusResponse* response = reinterpret_cast<OrderbookStatusResponse*>(data);
         response->toHostOrder();
 
-        std::cout << "Orderbook Status:" << std::endl;
+        std::cout << "Orderbook Status (symbol " << response->symbolId << "):" << std::endl;
 
         // Print bids (descending order)
         std::cout << "Bids:" << std::endl;
@@ -475,7 +491,8 @@ private:
         TradeNotification* notification = reinterpret_cast<TradeNotification*>(data);
         notification->toHostOrder();
 
-        std::cout << "Trade executed - Buy Order ID: " << notification->buyOrderId
+        std::cout << "Trade executed - Symbol: " << notification->symbolId
+            << ", Buy Order ID: " << notification->buyOrderId
             << ", Sell Order ID: " << notification->sellOrderId
             << ", Price: " << notification->price
             << ", Quantity: " << notification->quantity
@@ -493,6 +510,7 @@ private:
     std::atomic<bool> running_;
     std::thread receiverThread_;
     std::atomic<uint64_t> nextOrderId_;
+    std::atomic<uint16_t> symbolId_;  // Instrument orders are sent for
 };
 
 void displayHelp() {
@@ -501,10 +519,14 @@ void displayHelp() {
     std::cout << "  disconnect              - Disconnect from server" << std::endl;
     std::cout << "  echo <message>          - Send echo request" << std::endl;
     std::cout << "  users                   - Request list of connected users" << std::endl;
+    std::cout << "  symbol <symbol_id>      - Select instrument for orders (default 0)" << std::endl;
     std::cout << "  buy <price> <quantity>  - Place buy order" << std::endl;
     std::cout << "  sell <price> <quantity> - Place sell order" << std::endl;
     std::cout << "  fkbuy <price> <qty>     - Place fill-and-kill buy order" << std::endl;
     std::cout << "  fksell <price> <qty>    - Place fill-and-kill sell order" << std::endl;
+    std::cout << "  icebuy <price> <qty> <display>  - Place iceberg buy order showing <display> at a time" << std::endl;
+    std::cout << "  icesell <price> <qty> <display> - Place iceberg sell order showing <display> at a time" << std::endl;
+    std::cout << "  stop <side> <stop> <qty> [limit] - Place stop order, stop-limit if a limit price is given" << std::endl;
     std::cout << "  cancel <order_id>       - Cancel order" << std::endl;
     std::cout << "  modify <id> <side> <price> <qty> - Modify order" << std::endl;
     std::cout << "  book                    - Request orderbook status" << std::endl;
@@ -556,6 +578,18 @@ int main() {
         else if (cmd == "users") {
             client.sendListUsersRequest();
         }
+        else if (cmd == "symbol") {
+            int symbolId = -1;
+            iss >> symbolId;
+
+            if (symbolId < 0 || symbolId > 0xFFFF) {
+                std::cout << "Usage: symbol <symbol_id>" << std::endl;
+                continue;
+            }
+
+            client.setSymbol(static_cast<uint16_t>(symbolId));
+            std::cout << "Trading symbol " << client.getSymbol() << std::endl;
+        }
         else if (cmd == "buy") {
             uint32_t price, quantity;
             iss >> price >> quantity;
@@ -600,6 +634,32 @@ int main() {
 
             client.sendAddOrderRequest(OrderType::FillAndKill, Side::Sell, price, quantity);
         }
+        else if (cmd == "icebuy" || cmd == "icesell") {
+            uint32_t price = 0, quantity = 0, display = 0;
+            iss >> price >> quantity >> display;
+
+            if (price <= 0 || quantity <= 0 || display <= 0) {
+                std::cout << "Usage: " << cmd << " <price> <quantity> <display>" << std::endl;
+                continue;
+            }
+
+            client.sendAddOrderRequest(OrderType::GoodTillCancel, cmd == "icebuy" ? Side::Buy : Side::Sell, price, quantity, 0, display);
+        }
+        else if (cmd == "stop") {
+            std::string sideStr;
+            uint32_t stopPrice = 0, quantity = 0, limitPrice = 0;
+            iss >> sideStr >> stopPrice >> quantity >> limitPrice;
+
+            if (sideStr.empty() || stopPrice <= 0 || quantity <= 0) {
+                std::cout << "Usage: stop <side:buy|sell> <stop_price> <quantity> [limit_price]" << std::endl;
+                continue;
+            }
+
+            Side side = (sideStr == "buy" || sideStr == "b") ? Side::Buy : Side::Sell;
+            OrderType orderType = limitPrice > 0 ? OrderType::StopLimit : OrderType::Stop;
+
+            client.sendAddOrderRequest(orderType, side, limitPrice, quantity, 0, 0, stopPrice);
+        }
         else if (cmd == "cancel") {
             uint64_t orderId;
             iss >> orderId;
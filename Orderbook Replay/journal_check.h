@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../Orderbook Server/journal.h"
+
+// Recovery checks for JournalWriter against a real file: every check writes a journal, damages it the
+// way a crash would, reopens it and compares what survived with what has to. Run with  replay --check-journal
+namespace JournalCheck
+{
+    constexpr std::size_t FileSize = std::size_t{ 64 } << 10;
+
+    struct Recovered
+    {
+        std::vector<std::uint64_t> sequences_;
+        std::vector<std::uint64_t> orderIDs_;
+        std::uint64_t committed_{ };
+    };
+
+    // appends a cancel for each order ID and returns once all of them are on disk
+    inline void Write(const std::string& path, const std::vector<OrderID>& orderIDs)
+    {
+        JournalWriter writer{ path, FileSize };
+        for (auto orderID : orderIDs)
+            writer.Append(JournalRecord::Cancel(0, 0, orderID));
+        writer.Stop();
+    }
+
+    inline Recovered Reopen(const std::string& path)
+    {
+        JournalWriter writer{ path, FileSize };
+        Recovered recovered;
+        writer.ForEach([&recovered](const JournalRecord& record)
+            {
+                recovered.sequences_.push_back(record.sequence_);
+                recovered.orderIDs_.push_back(record.orderID_);
+            });
+        recovered.committed_ = writer.Committed();
+        return recovered;
+    }
+
+    // flips one byte of the record at index, so its checksum no longer matches
+    inline void Corrupt(const std::string& path, std::size_t index)
+    {
+        std::fstream file{ path, std::ios::in | std::ios::out | std::ios::binary };
+        const auto offset = static_cast<std::streamoff>(JournalHeader::Size + index * sizeof(JournalRecord) + offsetof(JournalRecord, orderID_));
+        file.seekg(offset);
+        char byte = 0;
+        file.get(byte);
+        file.seekp(offset);
+        file.put(static_cast<char>(byte ^ 0x5A));
+    }
+
+    inline bool Expect(const char* check, const Recovered& recovered, const std::vector<std::uint64_t>& sequences, const std::vector<std::uint64_t>& orderIDs)
+    {
+        if (recovered.sequences_ == sequences && recovered.orderIDs_ == orderIDs && recovered.committed_ == sequences.size())
+            return true;
+
+        std::cerr << check << ": recovered " << recovered.sequences_.size() << " records, committed " << recovered.committed_
+            << ", expected " << sequences.size() << std::endl;
+        for (std::size_t index = 0; index < recovered.sequences_.size(); ++index)
+            std::cerr << "  sequence " << recovered.sequences_[index] << " order " << recovered.orderIDs_[index] << std::endl;
+        return false;
+    }
+
+    // a batch torn after its third record: the first three survive and new records number on from there
+    inline bool TornBatch(const std::string& path)
+    {
+        Write(path, { 1, 2, 3, 4, 5 });
+        Corrupt(path, 3);
+        if (!Expect("torn batch", Reopen(path), { 1, 2, 3 }, { 1, 2, 3 }))
+            return false;
+
+        Write(path, { 6 });
+        return Expect("torn batch, appended after", Reopen(path), { 1, 2, 3, 4 }, { 1, 2, 3, 6 });
+    }
+
+    // the file cut off in the middle of a record: everything before the cut survives
+    inline bool Truncated(const std::string& path)
+    {
+        Write(path, { 1, 2, 3, 4 });
+        std::filesystem::resize_file(path, JournalHeader::Size + 2 * sizeof(JournalRecord) + sizeof(JournalRecord) / 2);
+        if (!Expect("truncated", Reopen(path), { 1, 2 }, { 1, 2 }))
+            return false;
+
+        Write(path, { 5, 6 });
+        return Expect("truncated, appended after", Reopen(path), { 1, 2, 3, 4 }, { 1, 2, 5, 6 });
+    }
+
+    // a torn first record leaves nothing to recover; the intact records behind it must not come back once
+    // a new record has been written over the first slot
+    inline bool TornFirstRecord(const std::string& path)
+    {
+        Write(path, { 1, 2, 3, 4, 5 });
+        Corrupt(path, 0);
+        if (!Expect("torn first record", Reopen(path), { }, { }))
+            return false;
+
+        Write(path, { 6 });
+        return Expect("torn first record, appended after", Reopen(path), { 1 }, { 6 });
+    }
+
+    // runs every check in the temp directory; reports each failure on std::cerr and returns whether all passed
+    inline bool Run()
+    {
+        const auto path = (std::filesystem::temp_directory_path() / "replay_journal_check.journal").string();
+
+        bool passed = true;
+        for (auto check : { &TornBatch, &Truncated, &TornFirstRecord })
+        {
+            std::filesystem::remove(path);
+            passed = check(path) && passed;
+        }
+
+        std::filesystem::remove(path);
+        return passed;
+    }
+}
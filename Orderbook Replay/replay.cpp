@@ -0,0 +1,616 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <filesystem>
+#include <variant>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "../Orderbook Server/journal.h"
+#include "../Orderbook Server/book_snapshot.h"
+#include "journal_check.h"
+
+// Replay tool: reads a server journal or a CSV order file and drives Orderbook with it on one
+// thread, no networking, as fast as it goes. It reports throughput, latency percentiles per
+// command type, and digests of the trade stream and of the final books. The same input always
+// gives the same digests, so an engine change that moves them changed matching results.
+//
+//   replay <journal or csv> [--symbol <id>] [--passes <n>] [--expect <digest>] [--expect-listing <file>]
+//          [--allocation <fifo|prorata|toporder>] [--tick <size>] [--checkpoints <on|off>]
+//   replay --check-journal
+//
+// CSV lines are  action,order_id,side,price,quantity[,order_type,expiry,display_quantity,stop_price]
+// with action A (add), C (cancel, only order_id is read) or M (modify), side B or S, and order_type
+// the wire code (0 GoodTillCancel ... 7 StopLimit, GoodTillCancel if omitted). A line  T,<timestamp>
+// moves the expiry clock for the commands after it, O starts an auction call phase and U uncrosses it.
+// A line  S  is a checkpoint: every book is saved to a snapshot and replaced by the book loaded back from
+// it, so the commands after it run the way a restart replays the journal written after a snapshot. A
+// restored book has to give the same digests as the one it replaced; --checkpoints off skips them. Empty lines, # comments and a header line
+// starting with "action" are skipped. Everything in a CSV file goes to symbol 0. Every book is created
+// with the given allocation policy and tick size, FIFO and 1 by default. --check-journal runs the journal
+// recovery checks in journal_check.h instead of a replay.
+//
+// --expect-listing compares the first pass with a listing written by hand: every trade in order, then the
+// final book the way ForEachLevel walks it, one line each, # comments and blank lines ignored:
+//   trade <bid order> <bid price> <ask order> <ask price> <quantity>
+//   level <bids|asks|buystops|sellstops> <price>
+//   order <order> <remaining> <shown> [top]
+// Symbols other than 0 put a line  symbol <id>  before their book.
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr std::size_t CommandTypes = 5;
+    const char* const CommandNames[CommandTypes] = { "add", "cancel", "modify", "auction", "uncross" };
+
+    // only valid for commands that passed IsKnownCommand
+    std::size_t TypeIndex(const JournalRecord& command)
+    {
+        return static_cast<std::size_t>(command.type_) - 1;
+    }
+
+    const char* const QueueNames[] = { "bids", "asks", "buystops", "sellstops" };
+
+    constexpr std::uint8_t MaxOrderType = static_cast<std::uint8_t>(OrderType::StopLimit);
+
+    // a record this build knows how to apply: a command type it counts, and for adds an order type and side it has
+    bool IsKnownCommand(const JournalRecord& command)
+    {
+        const auto type = static_cast<std::size_t>(command.type_);
+        if (type < 1 || type > CommandTypes)
+            return false;
+
+        return command.type_ != JournalRecord::Type::Add || (command.orderType_ <= MaxOrderType && command.side_ <= 1);
+    }
+
+    // FNV-1a over 64-bit words, in the order they are fed
+    class Digest
+    {
+    public:
+        void Add(std::uint64_t value)
+        {
+            for (int byte = 0; byte < 8; ++byte)
+            {
+                hash_ = (hash_ ^ ((value >> (byte * 8)) & 0xFF)) * 1099511628211ull;
+            }
+        }
+
+        std::uint64_t Value() const { return hash_; }
+
+    private:
+        std::uint64_t hash_{ 14695981039346656037ull };
+    };
+
+    std::string Hex(std::uint64_t value)
+    {
+        std::ostringstream out;
+        out << std::hex << std::setw(16) << std::setfill('0') << value;
+        return out.str();
+    }
+
+    // throws std::runtime_error on a record it cannot replay; skipping it would change every digest after it
+    std::vector<JournalRecord> LoadJournal(const std::string& path)
+    {
+        MappedFile file{ path, 0 };
+        std::vector<JournalRecord> commands;
+        ForEachJournalRecord(file.Data(), file.Size(), [&](const JournalRecord& record)
+            {
+                if (!IsKnownCommand(record))
+                    throw std::runtime_error(path + ": record " + std::to_string(record.sequence_) + " has an unknown command or order type");
+                commands.push_back(record);
+            });
+        return commands;
+    }
+
+    // throws std::runtime_error if the file cannot be read; malformed lines are reported and skipped.
+    // checkpoints gets the index of the command each S line comes before
+    std::vector<JournalRecord> LoadCsv(const std::string& path, std::vector<std::size_t>& checkpoints)
+    {
+        std::ifstream in{ path };
+        if (!in)
+            throw std::runtime_error(path + ": cannot open");
+
+        std::vector<JournalRecord> commands;
+        Timestamp clock = 0;
+
+        std::string line;
+        for (std::size_t lineNumber = 1; std::getline(in, line); ++lineNumber)
+        {
+            if (line.empty() || line[0] == '#' || line.rfind("action", 0) == 0)
+                continue;
+
+            std::vector<std::string> fields;
+            std::stringstream stream{ line };
+            for (std::string field; std::getline(stream, field, ','); )
+                fields.push_back(field);
+
+            auto number = [&](std::size_t index, std::uint64_t fallback) -> std::uint64_t
+                {
+                    return index < fields.size() && !fields[index].empty() ? std::strtoull(fields[index].c_str(), nullptr, 10) : fallback;
+                };
+            auto price = [&](std::size_t index, Price fallback) -> Price
+                {
+                    return index < fields.size() && !fields[index].empty() ? static_cast<Price>(std::strtol(fields[index].c_str(), nullptr, 10)) : fallback;
+                };
+
+            auto malformed = [&]
+                {
+                    std::cerr << path << ":" << lineNumber << ": skipping malformed line" << std::endl;
+                };
+
+            if (fields.empty() || fields[0].empty())
+            {
+                malformed();
+                continue;
+            }
+
+            const char action = static_cast<char>(std::toupper(static_cast<unsigned char>(fields[0][0])));
+            if (action == 'T')
+            {
+                clock = number(1, clock);
+                continue;
+            }
+
+            if (action == 'S')
+            {
+                checkpoints.push_back(commands.size());
+                continue;
+            }
+
+            if (action == 'O' || action == 'U')
+            {
+                commands.push_back(action == 'O' ? JournalRecord::StartAuction(0, clock) : JournalRecord::Uncross(0, clock));
+                continue;
+            }
+
+            if (action == 'C' && fields.size() >= 2)
+            {
+                commands.push_back(JournalRecord::Cancel(0, clock, number(1, 0)));
+                continue;
+            }
+
+            if (fields.size() < 5 || (action != 'A' && action != 'M') || fields[2].empty())
+            {
+                malformed();
+                continue;
+            }
+
+            const auto side = std::toupper(static_cast<unsigned char>(fields[2][0])) == 'S' ? Side::Sell : Side::Buy;
+            const auto quantity = static_cast<Quantity>(number(4, 0));
+            if (action == 'M')
+            {
+                commands.push_back(JournalRecord::Modify(0, clock, OrderModify{ number(1, 0), side, price(3, 0), quantity }));
+                continue;
+            }
+
+            const auto orderType = number(5, 0);
+            if (orderType > MaxOrderType)
+            {
+                malformed();
+                continue;
+            }
+
+            commands.push_back(JournalRecord::Add(0, clock, Order{ static_cast<OrderType>(orderType), number(1, 0), side, price(3, Constants::InvalidPrice),
+                quantity, number(6, 0), static_cast<Quantity>(number(7, 0)), price(8, Constants::InvalidPrice) }));
+        }
+
+        return commands;
+    }
+
+    // the listing lines of an --expect-listing file, comments and runs of blanks dropped.
+    // Throws std::runtime_error if the file cannot be read
+    std::vector<std::string> LoadListing(const std::string& path)
+    {
+        std::ifstream in{ path };
+        if (!in)
+            throw std::runtime_error(path + ": cannot open");
+
+        std::vector<std::string> listing;
+        for (std::string line; std::getline(in, line); )
+        {
+            std::stringstream stream{ line.substr(0, line.find('#')) };
+            std::string normalized;
+            for (std::string word; stream >> word; )
+                normalized += (normalized.empty() ? "" : " ") + word;
+
+            if (!normalized.empty())
+                listing.push_back(normalized);
+        }
+        return listing;
+    }
+
+    // reports the first line where the replay differs from the expected listing, then the whole listing it produced
+    bool MatchesListing(const std::vector<std::string>& expected, const std::vector<std::string>& actual)
+    {
+        const auto size = std::min(expected.size(), actual.size());
+        const auto mismatch = std::mismatch(expected.begin(), expected.begin() + size, actual.begin()).first - expected.begin();
+        if (static_cast<std::size_t>(mismatch) == size && expected.size() == actual.size())
+            return true;
+
+        std::cerr << "listing line " << mismatch + 1 << ": expected \""
+            << (static_cast<std::size_t>(mismatch) < expected.size() ? expected[mismatch] : "<end>") << "\", got \""
+            << (static_cast<std::size_t>(mismatch) < actual.size() ? actual[mismatch] : "<end>") << "\"" << std::endl
+            << "the replay listed:" << std::endl;
+        for (const auto& line : actual)
+            std::cerr << "  " << line << std::endl;
+        return false;
+    }
+
+    bool IsJournal(const std::string& path)
+    {
+        std::ifstream in{ path, std::ios::binary };
+        std::uint64_t magic = 0;
+        in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+        return in && magic == JournalHeader::ExpectedMagic;
+    }
+
+    struct ReplayResult
+    {
+        double seconds_{ };
+        std::uint64_t trades_{ };
+        std::uint64_t tradeDigest_{ };
+        std::uint64_t bookDigest_{ };
+    };
+
+    // saves every book to a snapshot and swaps in the book loaded back from it. Throws std::runtime_error if a
+    // snapshot cannot be written or read
+    void Checkpoint(std::vector<std::unique_ptr<AnyOrderbook>>& books)
+    {
+        for (std::size_t symbol = 0; symbol < books.size(); ++symbol)
+        {
+            const auto path = (std::filesystem::temp_directory_path() / ("replay_checkpoint_" + std::to_string(symbol) + ".snapshot")).string();
+            std::visit([&](const auto& typed) { WriteBookSnapshot(path, typed, static_cast<std::uint16_t>(symbol), 0); }, *books[symbol]);
+            LoadBookSnapshot(path, books[symbol]);
+            std::filesystem::remove(path);
+        }
+    }
+
+    // one pass over the commands into fresh books, taking a checkpoint before each command listed in
+    // checkpoints. With latencies set, every command is timed on its own and its time goes to the list for
+    // its type; checkpoints are never timed. With listing set, every trade and then the final books are
+    // written to it in the --expect-listing format
+    ReplayResult Replay(const std::vector<JournalRecord>& commands, const std::vector<std::size_t>& checkpoints,
+        AllocationPolicy allocation, Price tickSize, std::vector<std::uint32_t>* latencies, std::vector<std::string>* listing)
+    {
+        std::uint16_t symbols = 0;
+        for (const auto& command : commands)
+            symbols = std::max<std::uint16_t>(symbols, command.symbol_ + 1);
+
+        std::vector<std::unique_ptr<AnyOrderbook>> books(symbols);
+        for (auto& book : books)
+            book = MakeOrderbook(allocation, tickSize);
+
+        ReplayResult result;
+        Digest trades;
+        auto sink = [&](const Trade& trade)
+            {
+                ++result.trades_;
+                trades.Add(trade.GetBidTrade().orderID_);
+                trades.Add(trade.GetAskTrade().orderID_);
+                trades.Add(static_cast<std::uint32_t>(trade.GetBidTrade().price_));
+                trades.Add(static_cast<std::uint32_t>(trade.GetAskTrade().price_));
+                trades.Add(trade.GetBidTrade().quantity_);
+
+                if (listing != nullptr)
+                {
+                    listing->push_back("trade " + std::to_string(trade.GetBidTrade().orderID_) + " " + std::to_string(trade.GetBidTrade().price_)
+                        + " " + std::to_string(trade.GetAskTrade().orderID_) + " " + std::to_string(trade.GetAskTrade().price_)
+                        + " " + std::to_string(trade.GetBidTrade().quantity_));
+                }
+            };
+
+        auto apply = [&sink](const JournalRecord& command, AnyOrderbook& book)
+            {
+                std::visit([&](auto& typed) { command.ApplyTo(typed, sink); }, book);
+            };
+
+        // the commands between two checkpoints run as one timed stretch
+        Clock::duration elapsed{ };
+        std::size_t next = 0;
+        for (std::size_t checkpoint = 0; checkpoint <= checkpoints.size(); ++checkpoint)
+        {
+            const auto end = checkpoint < checkpoints.size() ? checkpoints[checkpoint] : commands.size();
+            const auto start = Clock::now();
+            if (latencies == nullptr)
+            {
+                for (; next < end; ++next)
+                    apply(commands[next], *books[commands[next].symbol_]);
+            }
+            else
+            {
+                for (; next < end; ++next)
+                {
+                    const auto before = Clock::now();
+                    apply(commands[next], *books[commands[next].symbol_]);
+                    const auto after = Clock::now();
+                    latencies[TypeIndex(commands[next])].push_back(static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count()));
+                }
+            }
+            elapsed += Clock::now() - start;
+
+            if (checkpoint < checkpoints.size())
+                Checkpoint(books);
+        }
+        result.seconds_ = std::chrono::duration<double>(elapsed).count();
+        result.tradeDigest_ = trades.Value();
+
+        Digest book;
+        for (std::size_t symbol = 0; symbol < books.size(); ++symbol)
+        {
+            book.Add(symbol);
+            if (listing != nullptr && symbol != 0)
+                listing->push_back("symbol " + std::to_string(symbol));
+
+            std::visit([&book, listing](const auto& typed)
+                {
+                    typed.ForEachLevel([&book, listing](BookQueue queue, Price price, Quantity count)
+                        {
+                            book.Add(static_cast<std::uint64_t>(queue));
+                            book.Add(static_cast<std::uint32_t>(price));
+                            book.Add(count);
+
+                            if (listing != nullptr)
+                                listing->push_back(std::string{ "level " } + QueueNames[static_cast<std::size_t>(queue)] + " " + std::to_string(price));
+                        },
+                        [&book, listing](const Order& order, bool topOrder)
+                        {
+                            book.Add(order.GetOrderID());
+                            book.Add(static_cast<std::uint64_t>(order.GetOrderType()));
+                            book.Add(order.GetRemainingQuantity());
+                            book.Add(order.GetVisibleQuantity());
+                            book.Add(order.GetExpiry());
+
+                            if (listing != nullptr)
+                            {
+                                listing->push_back("order " + std::to_string(order.GetOrderID()) + " " + std::to_string(order.GetRemainingQuantity())
+                                    + " " + std::to_string(order.GetVisibleQuantity()) + (topOrder ? " top" : ""));
+                            }
+                        });
+                }, *books[symbol]);
+        }
+        result.bookDigest_ = book.Value();
+
+        return result;
+    }
+
+    std::uint64_t Combined(const ReplayResult& result)
+    {
+        Digest digest;
+        digest.Add(result.tradeDigest_);
+        digest.Add(result.bookDigest_);
+        return digest.Value();
+    }
+
+    // cost of the two clock reads around every timed command, so the percentiles can be read net of it
+    std::uint32_t TimerOverhead()
+    {
+        std::vector<std::uint32_t> samples(10'000);
+        for (auto& sample : samples)
+        {
+            const auto before = Clock::now();
+            const auto after = Clock::now();
+            sample = static_cast<std::uint32_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count());
+        }
+
+        std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+        return samples[samples.size() / 2];
+    }
+
+    void ReportLatencies(const char* name, std::vector<std::uint32_t>& latencies)
+    {
+        if (latencies.empty())
+            return;
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double fraction)
+            {
+                return latencies[std::min(latencies.size() - 1, static_cast<std::size_t>(fraction * latencies.size()))];
+            };
+
+        std::cout << std::left << std::setw(8) << name << std::right
+            << std::setw(10) << latencies.size()
+            << std::setw(8) << percentile(0.50)
+            << std::setw(8) << percentile(0.90)
+            << std::setw(8) << percentile(0.99)
+            << std::setw(9) << percentile(0.999)
+            << std::setw(10) << latencies.back() << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const char* const usage = "usage: replay <journal or csv> [--symbol <id>] [--passes <n>] [--expect <digest>] [--expect-listing <file>]"
+        " [--allocation <fifo|prorata|toporder>] [--tick <size>] [--checkpoints <on|off>]\n"
+        "       replay --check-journal";
+    if (argc < 2)
+    {
+        std::cerr << usage << std::endl;
+        return 2;
+    }
+
+    if (std::string{ argv[1] } == "--check-journal")
+    {
+        try
+        {
+            return JournalCheck::Run() ? 0 : 1;
+        }
+        catch (const std::exception& error)
+        {
+            std::cerr << error.what() << std::endl;
+            return 2;
+        }
+    }
+
+    const std::string path = argv[1];
+    int symbol = -1;
+    int passes = 3;
+    std::string expected;
+    std::string expectedListingPath;
+    AllocationPolicy allocation = AllocationPolicy::Fifo;
+    Price tickSize = 1;
+    bool checkpointing = true;
+    for (int arg = 2; arg < argc; arg += 2)
+    {
+        const std::string option = argv[arg];
+        if (arg + 1 == argc)
+        {
+            std::cerr << "option " << option << " needs a value" << std::endl << usage << std::endl;
+            return 2;
+        }
+
+        if (option == "--symbol")
+            symbol = std::atoi(argv[arg + 1]);
+        else if (option == "--passes")
+            passes = std::max(1, std::atoi(argv[arg + 1]));
+        else if (option == "--expect")
+            expected = argv[arg + 1];
+        else if (option == "--expect-listing")
+            expectedListingPath = argv[arg + 1];
+        else if (option == "--allocation")
+        {
+            const auto policy = ToAllocationPolicy(argv[arg + 1]);
+            if (!policy)
+            {
+                std::cerr << "unknown allocation policy " << argv[arg + 1] << std::endl << usage << std::endl;
+                return 2;
+            }
+            allocation = *policy;
+        }
+        else if (option == "--tick")
+        {
+            tickSize = static_cast<Price>(std::atoi(argv[arg + 1]));
+            if (tickSize <= 0)
+            {
+                std::cerr << "tick size has to be positive" << std::endl << usage << std::endl;
+                return 2;
+            }
+        }
+        else if (option == "--checkpoints")
+        {
+            const std::string value = argv[arg + 1];
+            if (value != "on" && value != "off")
+            {
+                std::cerr << "--checkpoints takes on or off" << std::endl << usage << std::endl;
+                return 2;
+            }
+            checkpointing = value == "on";
+        }
+        else
+        {
+            std::cerr << "unknown option " << option << std::endl << usage << std::endl;
+            return 2;
+        }
+    }
+
+    if (!std::filesystem::is_regular_file(path))
+    {
+        std::cerr << path << ": no such file" << std::endl;
+        return 2;
+    }
+
+    const bool journal = IsJournal(path);
+    std::vector<JournalRecord> commands;
+    std::vector<std::size_t> checkpoints;
+    std::vector<std::string> expectedListing;
+    try
+    {
+        commands = journal ? LoadJournal(path) : LoadCsv(path, checkpoints);
+        if (!expectedListingPath.empty())
+            expectedListing = LoadListing(expectedListingPath);
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 2;
+    }
+    if (!checkpointing)
+        checkpoints.clear();
+
+    // only CSV files carry checkpoints, and everything in them is symbol 0, so filtering never moves one
+    if (symbol >= 0)
+    {
+        commands.erase(std::remove_if(commands.begin(), commands.end(),
+            [symbol](const JournalRecord& command) { return command.symbol_ != symbol; }), commands.end());
+    }
+
+    std::size_t counts[CommandTypes]{ };
+    for (const auto& command : commands)
+        ++counts[TypeIndex(command)];
+
+    std::cout << path << " (" << (journal ? "journal" : "csv") << "): " << commands.size() << " commands, "
+        << counts[0] << " adds, " << counts[1] << " cancels, " << counts[2] << " modifies, " << counts[3] << " auctions, "
+        << counts[4] << " uncrosses, " << checkpoints.size() << " checkpoints" << std::endl << std::endl;
+
+    // untimed passes for throughput; every one has to produce the same digests. Then one timed pass for the
+    // latency distribution. A checkpoint that fails to save or load a book ends the replay
+    ReplayResult first;
+    ReplayResult timed;
+    std::vector<std::string> listing;
+    bool deterministic = true;
+    std::vector<std::uint32_t> latencies[CommandTypes];
+    try
+    {
+        for (int pass = 0; pass < passes; ++pass)
+        {
+            const auto result = Replay(commands, checkpoints, allocation, tickSize, nullptr,
+                pass == 0 && !expectedListingPath.empty() ? &listing : nullptr);
+            if (pass == 0)
+                first = result;
+            else if (result.tradeDigest_ != first.tradeDigest_ || result.bookDigest_ != first.bookDigest_)
+                deterministic = false;
+
+            std::cout << "pass " << pass + 1 << std::setw(10) << std::fixed << std::setprecision(2)
+                << commands.size() / result.seconds_ / 1e6 << " Mops/s  " << std::setprecision(3) << result.seconds_ << " s" << std::endl;
+        }
+
+        for (std::size_t type = 0; type < CommandTypes; ++type)
+            latencies[type].reserve(counts[type]);
+
+        timed = Replay(commands, checkpoints, allocation, tickSize, latencies, nullptr);
+    }
+    catch (const std::exception& error)
+    {
+        std::cerr << error.what() << std::endl;
+        return 2;
+    }
+
+    if (timed.tradeDigest_ != first.tradeDigest_ || timed.bookDigest_ != first.bookDigest_)
+        deterministic = false;
+
+    std::cout << std::endl << "latency ns, timer overhead " << TimerOverhead() << " ns included" << std::endl;
+    std::cout << std::left << std::setw(8) << "command" << std::right << std::setw(10) << "count" << std::setw(8) << "p50"
+        << std::setw(8) << "p90" << std::setw(8) << "p99" << std::setw(9) << "p99.9" << std::setw(10) << "max" << std::endl;
+    for (std::size_t type = 0; type < CommandTypes; ++type)
+        ReportLatencies(CommandNames[type], latencies[type]);
+
+    const auto digest = Hex(Combined(first));
+    std::cout << std::endl << first.trades_ << " trades" << std::endl
+        << "trade digest " << Hex(first.tradeDigest_) << std::endl
+        << "book digest  " << Hex(first.bookDigest_) << std::endl
+        << "digest       " << digest << std::endl;
+
+    if (!deterministic)
+    {
+        std::cerr << "passes disagree: matching is not deterministic" << std::endl;
+        return 1;
+    }
+
+    if (!expectedListingPath.empty() && !MatchesListing(expectedListing, listing))
+        return 1;
+
+    if (!expected.empty() && expected != digest)
+    {
+        std::cerr << "digest " << digest << " does not match the expected " << expected << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Runs the journal recovery checks, then replays every scenario listed in scenarios.txt and checks it
+# still produces its expected listing of trades and final book, and its expected digest.
+#   run_tests.sh <path to the replay executable>
+# Exits non-zero if any check fails.
+
+replay=$1
+if [ -z "$replay" ]; then
+    echo "usage: run_tests.sh <path to replay>" >&2
+    exit 2
+fi
+
+dir=$(dirname "$0")
+failed=0
+total=1
+if "$replay" --check-journal; then
+    echo "ok    journal recovery"
+else
+    echo "FAIL  journal recovery"
+    failed=1
+fi
+
+while read -r scenario listing digest options; do
+    case "$scenario" in
+        ''|'#'*) continue ;;
+    esac
+
+    total=$((total + 1))
+    # options are word-split on purpose, they are separate replay arguments
+    if "$replay" "$dir/$scenario" --passes 1 --expect-listing "$dir/$listing" --expect "$digest" $options > /dev/null; then
+        echo "ok    $scenario"
+    else
+        echo "FAIL  $scenario"
+        failed=$((failed + 1))
+    fi
+done < "$dir/scenarios.txt"
+
+echo "$((total - failed)) of $total checks passed"
+[ "$failed" -eq 0 ]
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+// Allocation policies decide how an aggressor's quantity is split across the orders resting at
+// one price level. The Orderbook takes one as a template argument, so the choice costs nothing
+// at run time.
+//
+// A Sequential policy fills the queue from the head, one order at a time, and needs nothing
+// else. Any other policy provides Allocate(quantity, total, resting, fills, ranks, count, hasTopOrder).
+// The book gathers the level's remaining quantities into resting[] in time priority, total being
+// their sum and quantity <= total the amount to hand out. A policy with TracksTopOrder has the
+// book remember each level's top order; when the level has one it is gathered first, at index 0,
+// and hasTopOrder is true. ranks is scratch space for count entries. Allocate writes each order's
+// share into fills[], and the shares must add up to exactly quantity.
+
+// the policies a book can be created with at run time, also the value stored in a book snapshot
+enum class AllocationPolicy : std::uint8_t
+{
+    Fifo = 0,
+    ProRata = 1,
+    TopOrder = 2,
+};
+
+// Strict price-time priority, the default
+struct FifoAllocation
+{
+    static constexpr AllocationPolicy Kind = AllocationPolicy::Fifo;
+    static constexpr bool Sequential = true;
+    static constexpr bool TracksTopOrder = false;
+};
+
+// Every order gets floor(quantity * resting / total). The lots lost to rounding, fewer than there are
+// orders, go one each to the orders with the largest fractional share (largest remainder), earlier
+// orders first on ties. There is no minimum fill: an order whose share rounds to nothing can still
+// get a lot by its remainder. The split only depends on the queue, so it is reproducible
+struct ProRataAllocation
+{
+    static constexpr AllocationPolicy Kind = AllocationPolicy::ProRata;
+    static constexpr bool Sequential = false;
+    static constexpr bool TracksTopOrder = false;
+
+    template <typename Quantity>
+    static constexpr void Allocate(Quantity quantity, Quantity total, const Quantity* resting, Quantity* fills, std::uint32_t* ranks,
+        std::size_t count, bool = false)
+    {
+        if (quantity >= total)
+        {
+            std::copy(resting, resting + count, fills);
+            return;
+        }
+
+        // the ratio is taken once in 32.32 fixed point, so the per-order pass is multiplies, a shift
+        // and compares with no branches or divisions, and vectorizes. The truncated ratio can only
+        // land one lot under the exact floor, which the compare puts back
+        const auto ratio = (static_cast<std::uint64_t>(quantity) << 32) / total;
+
+        std::uint64_t allocated = 0;
+        for (std::size_t index = 0; index < count; ++index)
+        {
+            const std::uint64_t share = (resting[index] * ratio) >> 32;
+            const auto exact = share + ((share + 1) * total <= std::uint64_t{ resting[index] } * quantity);
+            fills[index] = static_cast<Quantity>(exact);
+            allocated += exact;
+        }
+
+        const auto leftover = static_cast<std::size_t>(quantity - allocated);
+        if (leftover == 0)
+            return;
+
+        // the fractional part of an order's share, scaled by total so all of them compare exactly
+        const auto remainder = [&](std::uint32_t index)
+            {
+                return std::uint64_t{ resting[index] } * quantity - std::uint64_t{ fills[index] } * total;
+            };
+
+        // the leftover is the sum of the fractional parts, so at least that many orders have one and
+        // each of them gets at most one lot, never more than it rests. Only the leftover largest
+        // remainders are ever needed, so a partial sort is enough
+        for (std::size_t index = 0; index < count; ++index)
+            ranks[index] = static_cast<std::uint32_t>(index);
+
+        std::partial_sort(ranks, ranks + leftover, ranks + count, [&](std::uint32_t lhs, std::uint32_t rhs)
+            {
+                const auto left = remainder(lhs);
+                const auto right = remainder(rhs);
+                return left != right ? left > right : lhs < rhs;
+            });
+
+        for (std::size_t rank = 0; rank < leftover; ++rank)
+            ++fills[ranks[rank]];
+    }
+};
+
+// The level's top order, the one whose arrival set the side's best price at that level, is filled first.
+// Whatever the aggressor has left is then shared pro-rata among the rest of the queue. A level whose top
+// order has left, or that never improved on the best price, is shared pro-rata as a whole
+struct TopOrderAllocation
+{
+    static constexpr AllocationPolicy Kind = AllocationPolicy::TopOrder;
+    static constexpr bool Sequential = false;
+    static constexpr bool TracksTopOrder = true;
+
+    template <typename Quantity>
+    static constexpr void Allocate(Quantity quantity, Quantity total, const Quantity* resting, Quantity* fills, std::uint32_t* ranks,
+        std::size_t count, bool hasTopOrder)
+    {
+        if (!hasTopOrder)
+        {
+            ProRataAllocation::Allocate(quantity, total, resting, fills, ranks, count);
+            return;
+        }
+
+        fills[0] = std::min(quantity, resting[0]);
+
+        const auto remaining = static_cast<Quantity>(quantity - fills[0]);
+        if (remaining == 0)
+        {
+            std::fill(fills + 1, fills + count, Quantity{ 0 });
+            return;
+        }
+
+        ProRataAllocation::Allocate(remaining, static_cast<Quantity>(total - resting[0]), resting + 1, fills + 1, ranks, count - 1);
+    }
+};
+
+// the name used in configuration files and on command lines
+inline std::optional<AllocationPolicy> ToAllocationPolicy(std::string_view name)
+{
+    if (name == "fifo")
+        return AllocationPolicy::Fifo;
+    if (name == "prorata")
+        return AllocationPolicy::ProRata;
+    if (name == "toporder")
+        return AllocationPolicy::TopOrder;
+    return std::nullopt;
+}
+
+// Pinned splits, checked at compile time: any change to the rounding shows up as a build error
+namespace AllocationChecks
+{
+    template <typename Policy, std::size_t Count>
+    constexpr bool Splits(std::uint32_t quantity, const std::array<std::uint32_t, Count>& resting,
+        const std::array<std::uint32_t, Count>& expected, bool hasTopOrder = false)
+    {
+        std::uint32_t total = 0;
+        for (auto quantityAtOrder : resting)
+            total += quantityAtOrder;
+
+        std::array<std::uint32_t, Count> fills{ };
+        std::array<std::uint32_t, Count> ranks{ };
+        Policy::Allocate(quantity, total, resting.data(), fills.data(), ranks.data(), Count, hasTopOrder);
+        return fills == expected;
+    }
+
+    // exact shares 2.25, 3.15, 3.6: the lot lost to rounding goes to the largest fraction, not the queue head
+    static_assert(Splits<ProRataAllocation, 3>(9, { 25, 35, 40 }, { 2, 3, 4 }));
+    // equal fractions: the earlier order wins the tie
+    static_assert(Splits<ProRataAllocation, 2>(5, { 50, 50 }, { 3, 2 }));
+    // exact shares 0.7, 2.1, 4.2: an order whose share rounds to nothing still wins a lot by its remainder
+    static_assert(Splits<ProRataAllocation, 3>(7, { 10, 30, 60 }, { 1, 2, 4 }));
+    // exact shares 0.2, 0.3, 0.5: only the largest fractions trade
+    static_assert(Splits<ProRataAllocation, 3>(1, { 20, 30, 50 }, { 0, 0, 1 }));
+    // exact shares 1.8, 2.7, 4.5: the two lots lost to rounding go to the .8 and the .7
+    static_assert(Splits<ProRataAllocation, 3>(9, { 20, 30, 50 }, { 2, 3, 4 }));
+    // an aggressor at least as big as the level takes all of it
+    static_assert(Splits<ProRataAllocation, 3>(60, { 10, 20, 30 }, { 10, 20, 30 }));
+    // the top order is filled first, the rest is pro-rata over the others
+    static_assert(Splits<TopOrderAllocation, 3>(30, { 10, 20, 30 }, { 10, 8, 12 }, true));
+    // a top order bigger than the aggressor takes it all
+    static_assert(Splits<TopOrderAllocation, 2>(6, { 10, 20 }, { 6, 0 }, true));
+    // without a top order the level is plain pro-rata
+    static_assert(Splits<TopOrderAllocation, 3>(30, { 10, 20, 30 }, { 5, 10, 15 }, false));
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "orderbook_adapter.h"
+#include "task_queue.h"
+
+// compact instrument id carried in the wire messages, also the book's index in the manager
+using SymbolId = std::uint16_t;
+
+// How a symbol's book is created: how aggressors are split across a level, and the tick size
+struct BookConfig {
+    AllocationPolicy allocation_ = AllocationPolicy::Fifo;
+    Price tickSize_ = 1;
+};
+
+// Holds one Orderbook per symbol and partitions the symbols across dedicated matching threads.
+// Every shard is a single worker TaskQueue and the only thread that ever touches its books,
+// so books need no locks and unrelated symbols match in parallel on separate cores. Work for
+// a symbol is posted to its shard and runs in arrival order. After every task the shard
+// republishes the symbol's top of book into a seqlock, so status readers never queue behind
+// matching work. Each symbol's book has its own allocation policy and tick size (FIFO, tick 1
+// unless configured); tasks are handed the book as its concrete BasicOrderbook type.
+class BookManager {
+public:
+    BookManager(std::size_t shardCount, std::size_t symbolCount)
+        : books_(symbolCount),
+        configs_(symbolCount),
+        tops_(std::make_unique<SeqLock<TopOfBook>[]>(symbolCount)) {
+        shards_.reserve(shardCount);
+        for (std::size_t shard = 0; shard < shardCount; ++shard) {
+            shards_.push_back(std::make_unique<TaskQueue>(1));
+        }
+    }
+
+    BookManager(const BookManager&) = delete;
+    BookManager& operator=(const BookManager&) = delete;
+
+    std::size_t SymbolCount() const { return books_.size(); }
+    std::size_t ShardCount() const { return shards_.size(); }
+    std::size_t ShardOf(SymbolId symbol) const { return symbol % shards_.size(); }
+
+    // Sets how the symbol's book is created. Only books created afterwards use it, so configure
+    // symbols before posting any work; false if the symbol is out of range or the tick size is not positive
+    bool Configure(SymbolId symbol, const BookConfig& config) {
+        if (symbol >= books_.size() || config.tickSize_ <= 0) {
+            return false;
+        }
+
+        configs_[symbol] = config;
+        return true;
+    }
+
+    // Runs task(book) on the symbol's matching thread, book being the symbol's BasicOrderbook<Allocation>&,
+    // so task has to accept any of them (e.g. a lambda taking auto&); false if the symbol is out of range
+    template <typename Task>
+    bool Post(SymbolId symbol, Task&& task) {
+        if (symbol >= books_.size()) {
+            return false;
+        }
+
+        shards_[ShardOf(symbol)]->enqueue([this, symbol, task = std::forward<Task>(task)]() mutable {
+            std::visit([this, symbol, &task](auto& book) {
+                task(book);
+                tops_[symbol].Store(book.GetTopOfBook());
+                }, Book(symbol));
+            });
+        return true;
+    }
+
+    // Replaces the symbol's book, on its matching thread, with the one build(std::unique_ptr<AnyOrderbook>&)
+    // leaves behind. build starts from an empty book of the symbol's configuration and may fill it in or swap
+    // it for another, e.g. a book restored from a snapshot with the tick size and policy it was saved with.
+    // If build throws, the symbol keeps the book it had and the exception is handed to
+    // onError(const std::exception&); false if the symbol is out of range
+    template <typename Build, typename OnError>
+    bool Rebuild(SymbolId symbol, Build&& build, OnError&& onError) {
+        if (symbol >= books_.size()) {
+            return false;
+        }
+
+        shards_[ShardOf(symbol)]->enqueue([this, symbol, build = std::forward<Build>(build), onError = std::forward<OnError>(onError)]() mutable {
+            auto book = MakeOrderbook(configs_[symbol].allocation_, configs_[symbol].tickSize_);
+            try {
+                build(book);
+            }
+            catch (const std::exception& error) {
+                onError(error);
+                return;
+            }
+
+            books_[symbol] = std::move(book);
+            tops_[symbol].Store(TopOf(*books_[symbol]));
+            });
+        return true;
+    }
+
+    // Runs task(SymbolId, AnyOrderbook&) for every book that exists, each on its own matching thread
+    // between two of the symbol's tasks; std::visit the book to reach its concrete type
+    template <typename Task>
+    void ForEachBook(const Task& task) {
+        for (std::size_t shard = 0; shard < shards_.size(); ++shard) {
+            shards_[shard]->enqueue([this, shard, task] {
+                for (std::size_t symbol = shard; symbol < books_.size(); symbol += shards_.size()) {
+                    if (books_[symbol]) {
+                        task(static_cast<SymbolId>(symbol), *books_[symbol]);
+                    }
+                }
+                });
+        }
+    }
+
+    // Blocks until every task posted so far has run
+    void Wait() {
+        std::vector<std::future<void>> done;
+        for (auto& shard : shards_) {
+            auto reached = std::make_shared<std::promise<void>>();
+            done.push_back(reached->get_future());
+            shard->enqueue([reached] { reached->set_value(); });
+        }
+
+        for (auto& shard : done) {
+            shard.wait();
+        }
+    }
+
+    // Best levels of the symbol as of its last task, from any thread and without going through the shard
+    bool GetTopOfBook(SymbolId symbol, TopOfBook& top) const {
+        if (symbol >= books_.size()) {
+            return false;
+        }
+
+        top = tops_[symbol].Load();
+        return true;
+    }
+
+    // Expires due orders in every book, each shard on its own matching thread
+    void ExpireOrders(Timestamp now) {
+        for (std::size_t shard = 0; shard < shards_.size(); ++shard) {
+            shards_[shard]->enqueue([this, shard, now] {
+                for (std::size_t symbol = shard; symbol < books_.size(); symbol += shards_.size()) {
+                    if (books_[symbol] && std::visit([now](auto& book) { return book.ExpireOrders(now); }, *books_[symbol]) != 0) {
+                        tops_[symbol].Store(TopOf(*books_[symbol]));
+                    }
+                }
+                });
+        }
+    }
+
+private:
+    // Books are created on first use, by the shard thread that owns them
+    AnyOrderbook& Book(SymbolId symbol) {
+        std::unique_ptr<AnyOrderbook>& book = books_[symbol];
+        if (!book) {
+            book = MakeOrderbook(configs_[symbol].allocation_, configs_[symbol].tickSize_);
+        }
+        return *book;
+    }
+
+    static TopOfBook TopOf(const AnyOrderbook& book) {
+        return std::visit([](const auto& typed) { return typed.GetTopOfBook(); }, book);
+    }
+
+    std::vector<std::unique_ptr<AnyOrderbook>> books_; // Indexed by symbol, each slot only touched by its shard
+    std::vector<BookConfig> configs_;                  // Indexed by symbol, set before the symbol is used
+    std::unique_ptr<SeqLock<TopOfBook>[]> tops_;       // Indexed by symbol, written by its shard, read by anyone
+    std::vector<std::unique_ptr<TaskQueue>> shards_;   // Declared last so the threads stop before the books go away
+};
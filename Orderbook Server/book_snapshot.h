@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "orderbook.cpp"
+#include "mapped_file.h"
+
+// A book snapshot is one flat file: a header, then every level of the book in the order
+// Orderbook::ForEachLevel walks them, each level record directly followed by its orders in time
+// priority. Records are fixed size, host byte order, and hold no pointers or pool handles, so the
+// file is read straight out of a mapping and the book is rebuilt in one sequential pass with no
+// matching. Together with the journal it replaces a replay from the start of the day: load the
+// snapshot, then apply only the journal records after sequence_. The header also records how the
+// book was created, its tick size and allocation policy, so it comes back the same way.
+struct SnapshotHeader
+{
+    static constexpr std::uint64_t ExpectedMagic = 0x3130'5041'4E53'424Full; // "OBSNAP01"
+
+    std::uint64_t magic_{ ExpectedMagic };
+    std::uint64_t sequence_{ };       // last journal record applied to the book when it was saved
+    std::uint64_t clock_{ };          // the book's expiry clock
+    std::uint64_t orderCount_{ };
+    std::uint64_t levelCount_{ };
+    std::int32_t tickSize_{ };
+    std::int32_t lastTradePrice_{ };
+    std::uint16_t symbol_{ };
+    std::uint8_t inAuction_{ };
+    AllocationPolicy allocation_{ };  // 0, FIFO, in snapshots written before the policy was recorded
+    std::uint8_t reserved_[12]{ };
+};
+
+struct SnapshotLevel
+{
+    std::int32_t price_{ };           // the stop price for stop trigger levels
+    std::uint32_t count_{ };
+    BookQueue queue_{ };
+    std::uint8_t reserved_[7]{ };
+};
+
+struct SnapshotOrder
+{
+    std::uint64_t orderID_{ };
+    std::uint64_t expiry_{ };
+    std::int32_t price_{ };
+    std::int32_t stopPrice_{ };
+    std::uint32_t initialQuantity_{ };
+    std::uint32_t remainingQuantity_{ };
+    std::uint32_t visibleQuantity_{ };
+    std::uint32_t displayQuantity_{ };
+    std::uint8_t orderType_{ };
+    std::uint8_t topOrder_{ };        // 1 for its level's top order, under a policy that tracks one
+    std::uint8_t reserved_[6]{ };
+};
+
+static_assert(sizeof(SnapshotHeader) == 64 && sizeof(SnapshotLevel) == 16 && sizeof(SnapshotOrder) == 48,
+    "snapshot records are a fixed on-disk layout");
+
+// Writes a snapshot with the given header; walk(levelVisitor, orderVisitor) feeds it the book level by level
+// the way Orderbook::ForEachLevel does. The snapshot is written and flushed under a temporary name and then
+// renamed over path, so path only ever holds a complete snapshot.
+template <typename Walk>
+void WriteSnapshotFile(const std::string& path, const SnapshotHeader& header, Walk&& walk)
+{
+    const auto size = sizeof(SnapshotHeader) + header.levelCount_ * sizeof(SnapshotLevel) + header.orderCount_ * sizeof(SnapshotOrder);
+    const auto temporary = path + ".tmp";
+
+    // a mapped file is only ever grown, so a leftover from an interrupted save has to go first
+    std::filesystem::remove(temporary);
+    {
+        MappedFile file{ temporary, size };
+        auto* out = file.Data();
+        std::memcpy(out, &header, sizeof(header));
+        out += sizeof(header);
+
+        walk([&out](BookQueue queue, Price price, Quantity count)
+            {
+                SnapshotLevel level;
+                level.price_ = price;
+                level.count_ = count;
+                level.queue_ = queue;
+                std::memcpy(out, &level, sizeof(level));
+                out += sizeof(level);
+            },
+            [&out](const Order& order, bool topOrder)
+            {
+                SnapshotOrder saved;
+                saved.orderID_ = order.GetOrderID();
+                saved.expiry_ = order.GetExpiry();
+                saved.price_ = order.GetPrice();
+                saved.stopPrice_ = order.GetStopPrice();
+                saved.initialQuantity_ = order.GetInitialQuantity();
+                saved.remainingQuantity_ = order.GetRemainingQuantity();
+                saved.visibleQuantity_ = order.GetVisibleQuantity();
+                saved.displayQuantity_ = order.GetDisplayQuantity();
+                saved.orderType_ = static_cast<std::uint8_t>(order.GetOrderType());
+                saved.topOrder_ = topOrder;
+                std::memcpy(out, &saved, sizeof(saved));
+                out += sizeof(saved);
+            });
+
+        file.Flush(0, size);
+    }
+
+    std::filesystem::rename(temporary, path);
+}
+
+// Saves book to path as of journal record sequence, on the thread that owns the book.
+template <typename Book>
+void WriteBookSnapshot(const std::string& path, const Book& book, std::uint16_t symbol, std::uint64_t sequence)
+{
+    SnapshotHeader header;
+    header.sequence_ = sequence;
+    header.clock_ = book.Clock();
+    header.orderCount_ = book.Size();
+    header.levelCount_ = book.LevelCount();
+    header.tickSize_ = book.TickSize();
+    header.lastTradePrice_ = book.LastTradePrice();
+    header.symbol_ = symbol;
+    header.inAuction_ = book.InAuction();
+    header.allocation_ = book.AllocationKind();
+
+    WriteSnapshotFile(path, header, [&book](auto&& levelVisitor, auto&& orderVisitor) { book.ForEachLevel(levelVisitor, orderVisitor); });
+}
+
+// Saves a capture the book's matching thread took with BeginCapture, from any thread while matching
+// carries on, and ends the capture, also when the write fails.
+template <typename Book>
+void WriteCapturedSnapshot(const std::string& path, Book& book, const BookCapture& capture, std::uint16_t symbol, std::uint64_t sequence)
+{
+    SnapshotHeader header;
+    header.sequence_ = sequence;
+    header.clock_ = capture.clock_;
+    header.orderCount_ = capture.orderCount_;
+    header.levelCount_ = capture.levels_.size();
+    header.tickSize_ = capture.tickSize_;
+    header.lastTradePrice_ = capture.lastTradePrice_;
+    header.symbol_ = symbol;
+    header.inAuction_ = capture.inAuction_;
+    header.allocation_ = book.AllocationKind();
+
+    try
+    {
+        WriteSnapshotFile(path, header, [&book, &capture](auto&& levelVisitor, auto&& orderVisitor) { book.ForEachCaptured(capture, levelVisitor, orderVisitor); });
+    }
+    catch (...)
+    {
+        book.EndCapture();
+        throw;
+    }
+
+    book.EndCapture();
+}
+
+// Rebuilds book from the snapshot at path. book must be empty and use the snapshot's tick size and
+// allocation policy. Returns the header, whose sequence_ is the last journal record already reflected
+// in the book. Throws std::runtime_error if the file is not a complete snapshot.
+template <typename Book>
+SnapshotHeader LoadBookSnapshot(const std::string& path, Book& book)
+{
+    MappedFile file{ path, 0 };
+    const auto fail = [&path](const char* what) { throw std::runtime_error("snapshot " + path + ": " + what); };
+
+    SnapshotHeader header;
+    if (file.Size() < sizeof(header))
+        fail("truncated header");
+    std::memcpy(&header, file.Data(), sizeof(header));
+
+    if (header.magic_ != SnapshotHeader::ExpectedMagic)
+        fail("not a book snapshot");
+    if (file.Size() != sizeof(SnapshotHeader) + header.levelCount_ * sizeof(SnapshotLevel) + header.orderCount_ * sizeof(SnapshotOrder))
+        fail("size does not match its header");
+    if (header.tickSize_ != book.TickSize() || header.allocation_ != book.AllocationKind() || book.Size() != 0)
+        fail("book is not empty or has a different tick size or allocation policy");
+
+    book.BeginRestore(header.orderCount_, header.clock_, header.lastTradePrice_, header.inAuction_ != 0);
+
+    const auto* in = file.Data() + sizeof(header);
+    const auto* end = file.Data() + file.Size();
+    for (std::uint64_t levels = 0; levels < header.levelCount_; ++levels)
+    {
+        if (static_cast<std::size_t>(end - in) < sizeof(SnapshotLevel))
+            fail("level runs past the end of the file");
+
+        SnapshotLevel level;
+        std::memcpy(&level, in, sizeof(level));
+        in += sizeof(level);
+
+        if (static_cast<std::size_t>(end - in) < std::size_t{ level.count_ } * sizeof(SnapshotOrder))
+            fail("level runs past the end of the file");
+
+        const auto side = level.queue_ == BookQueue::Bids || level.queue_ == BookQueue::BuyStops ? Side::Buy : Side::Sell;
+        for (std::uint32_t count = 0; count < level.count_; ++count)
+        {
+            SnapshotOrder saved;
+            std::memcpy(&saved, in, sizeof(saved));
+            in += sizeof(saved);
+
+            book.RestoreOrder(Order{ static_cast<OrderType>(saved.orderType_), saved.orderID_, side, saved.price_,
+                saved.initialQuantity_, saved.remainingQuantity_, saved.visibleQuantity_, saved.expiry_,
+                saved.displayQuantity_, saved.stopPrice_ }, saved.topOrder_ != 0);
+        }
+    }
+
+    return header;
+}
+
+// Rebuilds a book from the snapshot at path, created with the tick size and allocation policy the snapshot
+// was saved with, into book. Returns the header like LoadBookSnapshot and throws the same way.
+inline SnapshotHeader LoadBookSnapshot(const std::string& path, std::unique_ptr<AnyOrderbook>& book)
+{
+    SnapshotHeader header;
+    {
+        MappedFile file{ path, 0 };
+        if (file.Size() < sizeof(header))
+            throw std::runtime_error("snapshot " + path + ": truncated header");
+        std::memcpy(&header, file.Data(), sizeof(header));
+    }
+
+    if (header.tickSize_ <= 0 || header.allocation_ > AllocationPolicy::TopOrder)
+        throw std::runtime_error("snapshot " + path + ": unknown tick size or allocation policy");
+
+    auto restored = MakeOrderbook(header.allocation_, header.tickSize_);
+    header = std::visit([&path](auto& typed) { return LoadBookSnapshot(path, typed); }, *restored);
+    book = std::move(restored);
+    return header;
+}
@@ -0,0 +1,382 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "orderbook.cpp"
+#include "mapped_file.h"
+#include "ring_buffer.h"
+
+// One accepted order command, exactly as the book applied it. The layout is fixed at 64 bytes,
+// host byte order, so the journal is a flat array of records after its header.
+struct JournalRecord
+{
+    enum class Type : std::uint8_t
+    {
+        Add = 1,
+        Cancel = 2,
+        Modify = 3,
+        StartAuction = 4,
+        Uncross = 5,
+    };
+
+    std::uint64_t sequence_{ };        // 1-based and unique; 0 marks space that was never written
+    std::uint64_t orderID_{ };
+    std::uint64_t expiry_{ };          // Add only, already resolved, so a replay does not depend on the clock
+    std::int32_t price_{ };
+    std::int32_t stopPrice_{ };
+    std::uint32_t quantity_{ };
+    std::uint32_t displayQuantity_{ };
+    std::uint32_t checksum_{ };        // over every other byte, catches records torn by a crash
+    std::uint16_t symbol_{ };
+    Type type_{ Type::Add };
+    std::uint8_t orderType_{ };
+    std::uint8_t side_{ };
+    std::uint8_t reserved_[7]{ };
+    std::uint64_t clock_{ };           // the book's expiry clock when it applied the command
+
+    static JournalRecord Add(std::uint16_t symbol, Timestamp clock, const Order& order)
+    {
+        JournalRecord record;
+        record.type_ = Type::Add;
+        record.symbol_ = symbol;
+        record.clock_ = clock;
+        record.orderID_ = order.GetOrderID();
+        record.orderType_ = static_cast<std::uint8_t>(order.GetOrderType());
+        record.side_ = static_cast<std::uint8_t>(order.GetSide());
+        record.price_ = order.GetPrice();
+        record.quantity_ = order.GetInitialQuantity();
+        record.expiry_ = order.GetExpiry();
+        record.displayQuantity_ = order.GetDisplayQuantity();
+        record.stopPrice_ = order.GetStopPrice();
+        return record;
+    }
+
+    static JournalRecord Cancel(std::uint16_t symbol, Timestamp clock, OrderID orderID)
+    {
+        JournalRecord record;
+        record.type_ = Type::Cancel;
+        record.symbol_ = symbol;
+        record.clock_ = clock;
+        record.orderID_ = orderID;
+        return record;
+    }
+
+    static JournalRecord Modify(std::uint16_t symbol, Timestamp clock, const OrderModify& modify)
+    {
+        JournalRecord record;
+        record.type_ = Type::Modify;
+        record.symbol_ = symbol;
+        record.clock_ = clock;
+        record.orderID_ = modify.GetOrderID();
+        record.side_ = static_cast<std::uint8_t>(modify.GetSide());
+        record.price_ = modify.GetPrice();
+        record.quantity_ = modify.GetQuantity();
+        return record;
+    }
+
+    // the book enters an auction call phase; only symbol_ and clock_ are used
+    static JournalRecord StartAuction(std::uint16_t symbol, Timestamp clock)
+    {
+        JournalRecord record;
+        record.type_ = Type::StartAuction;
+        record.symbol_ = symbol;
+        record.clock_ = clock;
+        return record;
+    }
+
+    // the book's call phase ends and it uncrosses; only symbol_ and clock_ are used
+    static JournalRecord Uncross(std::uint16_t symbol, Timestamp clock)
+    {
+        JournalRecord record;
+        record.type_ = Type::Uncross;
+        record.symbol_ = symbol;
+        record.clock_ = clock;
+        return record;
+    }
+
+    Order ToOrder() const
+    {
+        return Order{ static_cast<OrderType>(orderType_), orderID_, static_cast<Side>(side_), price_, quantity_, expiry_, displayQuantity_, stopPrice_ };
+    }
+
+    OrderModify ToModify() const
+    {
+        return OrderModify{ orderID_, static_cast<Side>(side_), price_, quantity_ };
+    }
+
+    // applies the command to the book it was recorded against, handing every fill to sink. The book's clock is
+    // first moved to where it stood, so exactly the orders that had expired by then are gone and the command
+    // sees the same book
+    template <typename Book, typename TradeSink>
+    void ApplyTo(Book& book, TradeSink&& sink) const
+    {
+        book.ExpireOrders(clock_);
+
+        switch (type_)
+        {
+        case Type::Add:
+            book.AddOrder(ToOrder(), sink);
+            break;
+        case Type::Cancel:
+            book.CancelOrder(orderID_);
+            break;
+        case Type::Modify:
+            book.MatchOrder(ToModify(), sink);
+            break;
+        case Type::StartAuction:
+            book.StartAuction();
+            break;
+        case Type::Uncross:
+            book.Uncross(sink);
+            break;
+        }
+    }
+
+    template <typename Book>
+    void ApplyTo(Book& book) const
+    {
+        ApplyTo(book, [](const Trade&) { });
+    }
+
+    // FNV-1a over the record with checksum_ taken as zero
+    std::uint32_t ComputeChecksum() const
+    {
+        JournalRecord copy = *this;
+        copy.checksum_ = 0;
+
+        unsigned char bytes[sizeof(JournalRecord)];
+        std::memcpy(bytes, &copy, sizeof(bytes));
+
+        std::uint32_t hash = 2166136261u;
+        for (auto byte : bytes)
+            hash = (hash ^ byte) * 16777619u;
+        return hash;
+    }
+
+    bool IsValid() const { return sequence_ != 0 && checksum_ == ComputeChecksum(); }
+};
+
+static_assert(sizeof(JournalRecord) == 64, "JournalRecord is a fixed on-disk layout");
+
+// The journal file starts with one header page, records follow back to back
+struct JournalHeader
+{
+    static constexpr std::uint64_t ExpectedMagic = 0x3130'4C4E'524A'424Full; // "OBJRNL01"
+    static constexpr std::size_t Size = 4096;
+
+    std::uint64_t magic_{ ExpectedMagic };
+    std::uint32_t recordSize_{ sizeof(JournalRecord) };
+};
+
+// Calls visitor(const JournalRecord&) for every intact record, in file order, and returns how many
+// there were. Stops at the first record that was never written or was torn by a crash
+template <typename Visitor>
+std::size_t ForEachJournalRecord(const std::byte* data, std::size_t size, Visitor&& visitor)
+{
+    if (size < JournalHeader::Size)
+        return 0;
+
+    JournalHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic_ != JournalHeader::ExpectedMagic || header.recordSize_ != sizeof(JournalRecord))
+        return 0;
+
+    std::size_t count = 0;
+    for (auto offset = JournalHeader::Size; offset + sizeof(JournalRecord) <= size; offset += sizeof(JournalRecord))
+    {
+        JournalRecord record;
+        std::memcpy(&record, data + offset, sizeof(record));
+        if (!record.IsValid())
+            break;
+
+        visitor(record);
+        ++count;
+    }
+
+    return count;
+}
+
+// Append-only write-ahead journal of order commands.
+// Matching threads only stamp a sequence number and push the record into a lock-free ring. A
+// dedicated writer thread copies whatever has queued up into a preallocated memory-mapped file
+// and makes the whole batch durable with one flush (group commit), so the fsync cost is shared
+// by every record in the batch and never lands on a matching thread. With nothing queued the writer
+// spins for a short while and then parks until the next Append wakes it. Records from one producer
+// thread reach the file in the order they were appended, and sequence numbers are unique and
+// increasing per producer. Reopening an existing journal continues after its last intact record.
+class JournalWriter
+{
+public:
+    static constexpr std::size_t RingCapacity = std::size_t{ 1 } << 16;
+    static constexpr std::size_t MaxBatch = 4096;
+    static constexpr int SpinsBeforePark = 64;
+
+    explicit JournalWriter(const std::string& path, std::size_t initialSize = std::size_t{ 64 } << 20)
+        : file_{ path, initialSize }
+        , ring_{ std::make_unique<MpscRing<JournalRecord, RingCapacity>>() }
+    {
+        Recover();
+        thread_ = std::thread([this] { Run(); });
+    }
+
+    JournalWriter(const JournalWriter&) = delete;
+    JournalWriter& operator=(const JournalWriter&) = delete;
+
+    ~JournalWriter()
+    {
+        Stop();
+    }
+
+    // writes and flushes everything appended before the call, then joins the writer thread
+    void Stop()
+    {
+        running_.store(false, std::memory_order_release);
+        Wake();
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    // any thread; returns the record's sequence number. Waits only if the writer has fallen a whole ring behind
+    std::uint64_t Append(JournalRecord record)
+    {
+        record.sequence_ = nextSequence_.fetch_add(1, std::memory_order_relaxed);
+        while (!ring_->TryPush(record))
+            std::this_thread::yield();
+        Wake();
+        return record.sequence_;
+    }
+
+    // visits the records that were in the journal when it was opened, in file order; only valid before the first Append
+    template <typename Visitor>
+    std::size_t ForEach(Visitor&& visitor) const
+    {
+        return ForEachJournalRecord(file_.Data(), file_.Size(), std::forward<Visitor>(visitor));
+    }
+
+    // makes the next sequence number larger than sequence. A snapshot can cover records a crash kept out of the
+    // journal, and a replay skips everything the snapshot covers, so new records have to number past it
+    void SkipPast(std::uint64_t sequence)
+    {
+        auto next = nextSequence_.load(std::memory_order_relaxed);
+        while (next <= sequence && !nextSequence_.compare_exchange_weak(next, sequence + 1, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // records on stable storage so far
+    std::uint64_t Committed() const { return committed_.load(std::memory_order_acquire); }
+
+    const std::string& Path() const { return file_.Path(); }
+
+private:
+    void Recover()
+    {
+        std::uint64_t lastSequence = 0;
+        const auto records = ForEachJournalRecord(file_.Data(), file_.Size(), [&lastSequence](const JournalRecord& record)
+            {
+                lastSequence = std::max(lastSequence, record.sequence_);
+            });
+
+        end_ = JournalHeader::Size + records * sizeof(JournalRecord);
+
+        if (records == 0)
+        {
+            // new or unusable file: start a fresh journal
+            const JournalHeader header;
+            std::memset(file_.Data(), 0, JournalHeader::Size);
+            std::memcpy(file_.Data(), &header, sizeof(header));
+        }
+
+        // whatever a crash left behind the last intact record (a torn batch, or a whole journal behind a torn
+        // first record) is wiped, or a later recovery could read it as part of the journal once new records
+        // have been written over the gap
+        static const JournalRecord empty{ };
+        for (auto offset = end_; offset + sizeof(JournalRecord) <= file_.Size(); offset += sizeof(JournalRecord))
+        {
+            if (std::memcmp(file_.Data() + offset, &empty, sizeof(JournalRecord)) != 0)
+                std::memset(file_.Data() + offset, 0, sizeof(JournalRecord));
+        }
+
+        const auto flushed = records == 0 ? 0 : end_;
+        file_.Flush(flushed, file_.Size() - flushed);
+
+        nextSequence_.store(lastSequence + 1, std::memory_order_relaxed);
+        committed_.store(records, std::memory_order_relaxed);
+    }
+
+    // bumps the counter the writer parks on, after the ring or running_ changed. While the writer is busy the
+    // notify finds nobody waiting
+    void Wake()
+    {
+        pending_.fetch_add(1, std::memory_order_release);
+        pending_.notify_one();
+    }
+
+    void Run()
+    {
+        int idle = 0;
+        for (;;)
+        {
+            // read before the ring is drained: a record pushed after the drain has bumped pending_ past this
+            // value by the time the writer parks, so the wait returns at once and no record is left behind
+            const auto pending = pending_.load(std::memory_order_acquire);
+            const bool running = running_.load(std::memory_order_acquire);
+            const auto start = end_;
+
+            std::size_t batch = 0;
+            JournalRecord record;
+            while (batch < MaxBatch && ring_->TryPop(record))
+            {
+                Write(record);
+                ++batch;
+            }
+
+            if (batch == 0)
+            {
+                // stop only once the ring is empty, so nothing appended before Stop is lost
+                if (!running)
+                    return;
+
+                if (++idle < SpinsBeforePark)
+                    std::this_thread::yield();
+                else
+                    pending_.wait(pending, std::memory_order_acquire);
+                continue;
+            }
+
+            idle = 0;
+            file_.Flush(start, end_ - start);
+            committed_.fetch_add(batch, std::memory_order_release);
+        }
+    }
+
+    void Write(JournalRecord& record)
+    {
+        // keep one zeroed record after the end, so a reader always finds where the journal stops
+        if (end_ + 2 * sizeof(JournalRecord) > file_.Size())
+        {
+            file_.Flush(0, end_);
+            file_.Grow(file_.Size() * 2);
+        }
+
+        record.checksum_ = record.ComputeChecksum();
+        std::memcpy(file_.Data() + end_, &record, sizeof(record));
+        end_ += sizeof(record);
+    }
+
+    MappedFile file_;
+    std::unique_ptr<MpscRing<JournalRecord, RingCapacity>> ring_;
+    std::size_t end_{ 0 };                          // writer thread only
+    alignas(CacheLineSize) std::atomic<std::uint64_t> nextSequence_{ 1 };
+    alignas(CacheLineSize) std::atomic<std::uint64_t> committed_{ 0 };
+    alignas(CacheLineSize) std::atomic<std::uint32_t> pending_{ 0 };   // bumped by every Append and by Stop
+    std::atomic<bool> running_{ true };
+    std::thread thread_;
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// A file mapped read/write into memory in one piece. Opening preallocates it to at least the
+// requested size, so writes into the mapping never allocate disk blocks or extend the file.
+// Flush makes a byte range durable (msync, or FlushViewOfFile + FlushFileBuffers on Windows).
+// Every failure throws std::runtime_error.
+class MappedFile
+{
+public:
+    MappedFile(const std::string& path, std::size_t minimumSize)
+        : path_{ path }
+    {
+        Open();
+        const auto size = CurrentSize();
+        Map(size < minimumSize ? minimumSize : size);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        Unmap();
+#ifdef _WIN32
+        if (file_ != INVALID_HANDLE_VALUE)
+            CloseHandle(file_);
+#else
+        if (file_ >= 0)
+            close(file_);
+#endif
+    }
+
+    std::byte* Data() { return data_; }
+    const std::byte* Data() const { return data_; }
+    std::size_t Size() const { return size_; }
+    const std::string& Path() const { return path_; }
+
+    // extends the file to newSize and maps it again; pointers into the old mapping are invalidated
+    void Grow(std::size_t newSize)
+    {
+        if (newSize <= size_)
+            return;
+
+        Unmap();
+        Map(newSize);
+    }
+
+    // blocks until [offset, offset + length) is on stable storage
+    void Flush(std::size_t offset, std::size_t length)
+    {
+        if (length == 0)
+            return;
+
+#ifdef _WIN32
+        if (!FlushViewOfFile(data_ + offset, length) || !FlushFileBuffers(file_))
+            Fail("flush");
+#else
+        // msync wants a page aligned start
+        static const auto pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+        const auto start = offset - offset % pageSize;
+        if (msync(data_ + start, offset + length - start, MS_SYNC) != 0)
+            Fail("msync");
+#endif
+    }
+
+private:
+    [[noreturn]] void Fail(const char* what) const
+    {
+        throw std::runtime_error("MappedFile " + path_ + ": " + what + " failed");
+    }
+
+#ifdef _WIN32
+    void Open()
+    {
+        file_ = CreateFileA(path_.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE)
+            Fail("open");
+    }
+
+    std::size_t CurrentSize() const
+    {
+        LARGE_INTEGER size{ };
+        if (!GetFileSizeEx(file_, &size))
+            Fail("stat");
+        return static_cast<std::size_t>(size.QuadPart);
+    }
+
+    // a mapping larger than the file extends the file
+    void Map(std::size_t size)
+    {
+        const auto high = static_cast<DWORD>(static_cast<std::uint64_t>(size) >> 32);
+        const auto low = static_cast<DWORD>(size & 0xFFFFFFFFu);
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READWRITE, high, low, nullptr);
+        if (mapping_ == nullptr)
+            Fail("map");
+
+        data_ = static_cast<std::byte*>(MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size));
+        if (data_ == nullptr)
+            Fail("map view");
+        size_ = size;
+    }
+
+    void Unmap()
+    {
+        if (data_ != nullptr)
+            UnmapViewOfFile(data_);
+        if (mapping_ != nullptr)
+            CloseHandle(mapping_);
+        data_ = nullptr;
+        mapping_ = nullptr;
+    }
+
+    HANDLE file_{ INVALID_HANDLE_VALUE };
+    HANDLE mapping_{ nullptr };
+#else
+    void Open()
+    {
+        file_ = open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+        if (file_ < 0)
+            Fail("open");
+    }
+
+    std::size_t CurrentSize() const
+    {
+        struct stat status{ };
+        if (fstat(file_, &status) != 0)
+            Fail("stat");
+        return static_cast<std::size_t>(status.st_size);
+    }
+
+    void Map(std::size_t size)
+    {
+        if (CurrentSize() < size)
+        {
+#ifdef __linux__
+            // reserve real blocks now rather than on first write through the mapping
+            if (posix_fallocate(file_, 0, static_cast<off_t>(size)) != 0)
+                Fail("fallocate");
+#else
+            if (ftruncate(file_, static_cast<off_t>(size)) != 0)
+                Fail("truncate");
+#endif
+        }
+
+        void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file_, 0);
+        if (data == MAP_FAILED)
+            Fail("mmap");
+        data_ = static_cast<std::byte*>(data);
+        size_ = size;
+    }
+
+    void Unmap()
+    {
+        if (data_ != nullptr)
+            munmap(data_, size_);
+        data_ = nullptr;
+    }
+
+    int file_{ -1 };
+#endif
+
+    std::string path_;
+    std::byte* data_{ nullptr };
+    std::size_t size_{ 0 };
+};
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "orderbook.cpp"
+#include "ring_buffer.h"
+#include "seqlock.h"
+
+using SessionId = std::uint32_t;
+
+// A decoded request for the matching thread
+struct EngineCommand
+{
+    enum class Type : std::uint8_t
+    {
+        Add,
+        Cancel,
+        Modify,
+        Expire,
+    };
+
+    Type type_{ Type::Add };
+    SessionId session_{ };  // where the results go
+    Order order_{ };        // Add: the order, Cancel: only its id, Modify: id, side, price and quantity
+    Timestamp now_{ };      // Expire only
+
+    static EngineCommand Add(SessionId session, const Order& order)
+    {
+        return EngineCommand{ Type::Add, session, order };
+    }
+
+    static EngineCommand Cancel(SessionId session, OrderID orderID)
+    {
+        return EngineCommand{ Type::Cancel, session, Order{ OrderType::GoodTillCancel, orderID, Side::Buy, 0, 0 } };
+    }
+
+    static EngineCommand Modify(SessionId session, const OrderModify& modify)
+    {
+        return EngineCommand{ Type::Modify, session, modify.ToOrder(OrderType::GoodTillCancel) };
+    }
+
+    static EngineCommand Expire(SessionId session, Timestamp now)
+    {
+        return EngineCommand{ Type::Expire, session, Order{ }, now };
+    }
+};
+
+// What the matching thread sends back to a session: every fill of its command, then Done
+struct EngineResult
+{
+    enum class Type : std::uint8_t
+    {
+        Trade,
+        Done,
+    };
+
+    Type type_{ Type::Done };
+    OrderID orderID_{ };    // order of the command this result belongs to
+    TradeInfo bidTrade_{ };
+    TradeInfo askTrade_{ };
+};
+
+// Single-writer alternative to ThreadSafeOrderbook: exactly one (optionally pinned) thread owns
+// the Orderbook, so the book's cache lines never migrate and there is no lock to contend on.
+// Session threads push decoded commands into one bounded MPSC ring and read their results from
+// their own SPSC ring. Commands run in the order they were pushed. The top of book is
+// republished into a seqlock after every command, so readers never go through the rings.
+//
+// It drives a single FIFO book and is a library component for embedding and for the engine
+// benchmark. The server does not use it: its books are sharded over BookManager's TaskQueues.
+class MatchingEngine
+{
+public:
+    static constexpr std::size_t IngressCapacity = std::size_t{ 1 } << 16;
+    static constexpr std::size_t ResultCapacity = std::size_t{ 1 } << 12;
+
+    // cpu < 0 leaves the matching thread unpinned
+    explicit MatchingEngine(std::size_t sessionCount, int cpu = -1, Price tickSize = 1, std::size_t orderCapacity = SlabPool<Order>::SlabSize)
+        : orderbook_{ tickSize, orderCapacity }
+        , ingress_{ std::make_unique<MpscRing<EngineCommand, IngressCapacity>>() }
+    {
+        results_.reserve(sessionCount);
+        for (std::size_t session = 0; session < sessionCount; ++session)
+            results_.push_back(std::make_unique<SpscRing<EngineResult, ResultCapacity>>());
+
+        thread_ = std::thread([this, cpu]
+            {
+                if (cpu >= 0)
+                    PinCurrentThread(cpu);
+                Run();
+            });
+    }
+
+    MatchingEngine(const MatchingEngine&) = delete;
+    MatchingEngine& operator=(const MatchingEngine&) = delete;
+
+    ~MatchingEngine()
+    {
+        Stop();
+    }
+
+    // runs whatever was submitted before the call, then joins the matching thread
+    void Stop()
+    {
+        running_.store(false, std::memory_order_release);
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    std::size_t SessionCount() const { return results_.size(); }
+
+    // any thread; false when the ingress ring is full and the caller should retry
+    bool Submit(const EngineCommand& command)
+    {
+        return ingress_->TryPush(command);
+    }
+
+    // only the session's own thread; false when no result is waiting
+    bool Poll(SessionId session, EngineResult& result)
+    {
+        return results_[session]->TryPop(result);
+    }
+
+    // any thread, as of the last executed command
+    TopOfBook GetTopOfBook() const
+    {
+        return top_.Load();
+    }
+
+private:
+    static void PinCurrentThread(int cpu)
+    {
+#ifdef _WIN32
+        SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{ 1 } << cpu);
+#else
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+    }
+
+    void Run()
+    {
+        EngineCommand command;
+        while (running_.load(std::memory_order_acquire))
+        {
+            if (ingress_->TryPop(command))
+                Execute(command);
+            else
+                std::this_thread::yield();
+        }
+
+        while (ingress_->TryPop(command))
+            Execute(command);
+    }
+
+    void Execute(const EngineCommand& command)
+    {
+        const auto session = command.session_;
+        const auto orderID = command.order_.GetOrderID();
+        auto sink = [this, session, orderID](const Trade& trade)
+            {
+                Publish(session, EngineResult{ EngineResult::Type::Trade, orderID, trade.GetBidTrade(), trade.GetAskTrade() });
+            };
+
+        switch (command.type_)
+        {
+        case EngineCommand::Type::Add:
+            orderbook_.AddOrder(command.order_, sink);
+            break;
+        case EngineCommand::Type::Cancel:
+            orderbook_.CancelOrder(orderID);
+            break;
+        case EngineCommand::Type::Modify:
+            orderbook_.MatchOrder(OrderModify{ orderID, command.order_.GetSide(), command.order_.GetPrice(), command.order_.GetInitialQuantity() }, sink);
+            break;
+        case EngineCommand::Type::Expire:
+            orderbook_.ExpireOrders(command.now_);
+            break;
+        }
+
+        top_.Store(orderbook_.GetTopOfBook());
+
+        Publish(session, EngineResult{ EngineResult::Type::Done, orderID });
+    }
+
+    // a session that stops polling stalls the matching thread instead of losing its results
+    void Publish(SessionId session, const EngineResult& result)
+    {
+        while (!results_[session]->TryPush(result))
+            std::this_thread::yield();
+    }
+
+    Orderbook orderbook_;
+    std::unique_ptr<MpscRing<EngineCommand, IngressCapacity>> ingress_;
+    std::vector<std::unique_ptr<SpscRing<EngineResult, ResultCapacity>>> results_;
+    SeqLock<TopOfBook> top_;
+    std::atomic<bool> running_{ true };
+    std::thread thread_;
+};
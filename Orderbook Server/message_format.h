@@ -77,7 +77,10 @@ enum class OrderType : uint8_t {
     FillAndKill = 1,
     FillOrKill = 2,
     GoodForDay = 3,
-    Market = 4
+    Market = 4,
+    GoodTillDate = 5,
+    Stop = 6,
+    StopLimit = 7
 };
 
 enum class Side : uint8_t {
@@ -88,24 +91,36 @@ enum class Side : uint8_t {
 // Request to add a new order
 struct AddOrderRequest {
     MessageHeader header;
+    uint16_t symbolId;       // Instrument the order is for
     OrderType orderType;
     Side side;
     uint32_t price;
     uint32_t quantity;
     uint64_t clientOrderId;  // Client-assigned order ID
+    uint64_t expiryTime;     // GoodTillDate only: unix seconds the order expires at
+    uint32_t displayQuantity; // Iceberg tranche shown in the book, 0 to show the whole order
+    uint32_t stopPrice;      // Stop/StopLimit only: trade price that triggers the order
 
     void toNetworkOrder() {
         header.toNetworkOrder();
+        symbolId = htons(symbolId);
         price = htonl(price);
         quantity = htonl(quantity);
         clientOrderId = htonll(clientOrderId);
+        expiryTime = htonll(expiryTime);
+        displayQuantity = htonl(displayQuantity);
+        stopPrice = htonl(stopPrice);
     }
 
     void toHostOrder() {
         header.toHostOrder();
+        symbolId = ntohs(symbolId);
         price = ntohl(price);
         quantity = ntohl(quantity);
         clientOrderId = ntohll(clientOrderId);
+        expiryTime = ntohll(expiryTime);
+        displayQuantity = ntohl(displayQuantity);
+        stopPrice = ntohl(stopPrice);
     }
 };
 
@@ -132,15 +147,18 @@ struct AddOrderResponse {
 // Cancel order request
 struct CancelOrderRequest {
     MessageHeader header;
+    uint16_t symbolId; // Instrument the order rests in
     uint64_t orderId;  // Order ID to cancel
 
     void toNetworkOrder() {
         header.toNetworkOrder();
+        symbolId = htons(symbolId);
         orderId = htonll(orderId);
     }
 
     void toHostOrder() {
         header.toHostOrder();
+        symbolId = ntohs(symbolId);
         orderId = ntohll(orderId);
     }
 };
@@ -165,6 +183,7 @@ struct CancelOrderResponse {
 // Modify order request
 struct ModifyOrderRequest {
     MessageHeader header;
+    uint16_t symbolId;
     uint64_t orderId;
     Side side;
     uint32_t price;
@@ -172,6 +191,7 @@ struct ModifyOrderRequest {
 
     void toNetworkOrder() {
         header.toNetworkOrder();
+        symbolId = htons(symbolId);
         orderId = htonll(orderId);
         price = htonl(price);
         quantity = htonl(quantity);
@@ -179,6 +199,7 @@ struct ModifyOrderRequest {
 
     void toHostOrder() {
         header.toHostOrder();
+        symbolId = ntohs(symbolId);
         orderId = ntohll(orderId);
         price = ntohl(price);
         quantity = ntohl(quantity);
@@ -188,6 +209,7 @@ struct ModifyOrderRequest {
 // Trade notification
 struct TradeNotification {
     MessageHeader header;
+    uint16_t symbolId;
     uint64_t buyOrderId;
     uint64_t sellOrderId;
     uint32_t price;
@@ -195,6 +217,7 @@ struct TradeNotification {
 
     void toNetworkOrder() {
         header.toNetworkOrder();
+        symbolId = htons(symbolId);
         buyOrderId = htonll(buyOrderId);
         sellOrderId = htonll(sellOrderId);
         price = htonl(price);
@@ -203,6 +226,7 @@ struct TradeNotification {
 
     void toHostOrder() {
         header.toHostOrder();
+        symbolId = ntohs(symbolId);
         buyOrderId = ntohll(buyOrderId);
         sellOrderId = ntohll(sellOrderId);
         price = ntohl(price);
@@ -229,9 +253,26 @@ struct NetworkLevelInfo {
 // Maximum number of levels to include in orderbook status
 constexpr int MAX_LEVELS = 10;
 
+// Orderbook status request
+struct OrderbookStatusRequest {
+    MessageHeader header;
+    uint16_t symbolId;  // Instrument whose book is requested
+
+    void toNetworkOrder() {
+        header.toNetworkOrder();
+        symbolId = htons(symbolId);
+    }
+
+    void toHostOrder() {
+        header.toHostOrder();
+        symbolId = ntohs(symbolId);
+    }
+};
+
 // Orderbook status response
 struct OrderbookStatusResponse {
     MessageHeader header;
+    uint16_t symbolId;
     uint32_t bidLevelsCount;
     uint32_t askLevelsCount;
     NetworkLevelInfo bidLevels[MAX_LEVELS];
@@ -239,6 +280,7 @@ struct OrderbookStatusResponse {
 
     void toNetworkOrder() {
         header.toNetworkOrder();
+        symbolId = htons(symbolId);
         bidLevelsCount = htonl(bidLevelsCount);
         askLevelsCount = htonl(askLevelsCount);
 
@@ -253,6 +295,7 @@ struct OrderbookStatusResponse {
 
     void toHostOrder() {
         header.toHostOrder();
+        symbolId = ntohs(symbolId);
         bidLevelsCount = ntohl(bidLevelsCount);
         askLevelsCount = ntohl(askLevelsCount);
 
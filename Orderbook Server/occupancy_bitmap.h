@@ -0,0 +1,127 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Hierarchical occupancy bitmap over the PriceLadder's slots.
+// Level 0 holds one bit per slot; every level above holds one bit per non-zero word of the
+// level below, up to a single top word. Finding the next occupied slot in either direction
+// is one count-zero per level (at most four for MaxLevels), however many empty slots lie in
+// between, so sweeping a sparse book costs the same as sweeping a dense one.
+class OccupancyBitmap
+{
+public:
+    static constexpr std::size_t NotFound = ~std::size_t{ 0 };
+
+    explicit OccupancyBitmap(std::size_t size = 0)
+    {
+        do
+        {
+            size = (size + WordBits - 1) / WordBits;
+            words_.emplace_back(size == 0 ? 1 : size, 0);
+        } while (size > 1);
+    }
+
+    bool Test(std::size_t index) const
+    {
+        return (words_[0][index / WordBits] >> (index % WordBits)) & 1;
+    }
+
+    void Set(std::size_t index)
+    {
+        for (auto& level : words_)
+        {
+            auto& word = level[index / WordBits];
+            const bool wasEmpty = word == 0;
+            word |= Bit(index);
+            // the summary bit above is already set
+            if (!wasEmpty)
+                return;
+            index /= WordBits;
+        }
+    }
+
+    void Clear(std::size_t index)
+    {
+        for (auto& level : words_)
+        {
+            auto& word = level[index / WordBits];
+            word &= ~Bit(index);
+            // the word still has bits, so the summary bit above stays
+            if (word != 0)
+                return;
+            index /= WordBits;
+        }
+    }
+
+    // lowest set index >= from, or NotFound
+    std::size_t NextSet(std::size_t from) const
+    {
+        std::size_t level = 0;
+        auto index = from;
+        for (;; ++level)
+        {
+            if (level == words_.size())
+                return NotFound;
+
+            const auto word = index / WordBits;
+            if (word >= words_[level].size())
+                return NotFound;
+
+            const auto bits = words_[level][word] & (~std::uint64_t{ 0 } << (index % WordBits));
+            if (bits != 0)
+            {
+                index = word * WordBits + std::countr_zero(bits);
+                break;
+            }
+
+            // nothing left in this word, continue from the next word one level up
+            index = word + 1;
+        }
+
+        while (level-- > 0)
+            index = index * WordBits + std::countr_zero(words_[level][index]);
+
+        return index;
+    }
+
+    // highest set index <= from, or NotFound
+    std::size_t PrevSet(std::size_t from) const
+    {
+        std::size_t level = 0;
+        auto index = from;
+        for (;; ++level)
+        {
+            if (level == words_.size())
+                return NotFound;
+
+            const auto word = index / WordBits;
+            const auto bits = words_[level][word] & (~std::uint64_t{ 0 } >> (WordBits - 1 - index % WordBits));
+            if (bits != 0)
+            {
+                index = word * WordBits + WordBits - 1 - std::countl_zero(bits);
+                break;
+            }
+
+            if (word == 0)
+                return NotFound;
+
+            // nothing left in this word, continue from the previous word one level up
+            index = word - 1;
+        }
+
+        while (level-- > 0)
+            index = index * WordBits + WordBits - 1 - std::countl_zero(words_[level][index]);
+
+        return index;
+    }
+
+private:
+    static constexpr std::size_t WordBits = 64;
+
+    static std::uint64_t Bit(std::size_t index) { return std::uint64_t{ 1 } << (index % WordBits); }
+
+    std::vector<std::vector<std::uint64_t>> words_; // words_[0] is the leaf level, words_.back() a single word
+};
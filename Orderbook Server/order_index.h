@@ -0,0 +1,168 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+// Flat open addressing index (Robin Hood probing) for OrderID -> OrderEntry lookups.
+// Slots live in one array, so there are no per-entry nodes. Erase uses backward
+// shift deletion, so no tombstones build up under cancel-heavy flow. Every
+// operation is a single probe sequence: Insert reports duplicates and Extract
+// finds and removes in one pass.
+template <typename Key, typename Value>
+class OrderIndex
+{
+public:
+    explicit OrderIndex(std::size_t expectedSize = 1024)
+    {
+        std::size_t capacity = 16;
+        while (capacity * MaxLoadNumerator < expectedSize * MaxLoadDenominator)
+            capacity *= 2;
+
+        Rehash(capacity);
+    }
+
+    std::size_t Size() const { return size_; }
+    std::size_t Capacity() const { return slots_.size(); }
+
+    bool Contains(Key key) const { return Find(key) != nullptr; }
+
+    // grows the table up front so the next expectedSize entries go in without a rehash
+    void Reserve(std::size_t expectedSize)
+    {
+        auto capacity = slots_.size();
+        while (capacity * MaxLoadNumerator < expectedSize * MaxLoadDenominator)
+            capacity *= 2;
+
+        if (capacity != slots_.size())
+            Rehash(capacity);
+    }
+
+    Value* Find(Key key)
+    {
+        auto index = Home(key);
+        for (std::uint32_t distance = 1; ; ++distance, index = Next(index))
+        {
+            auto& slot = slots_[index];
+            // a resident closer to its home than we are to ours means the key is absent
+            if (slot.distance_ < distance)
+                return nullptr;
+            if (slot.key_ == key)
+                return &slot.value_;
+        }
+    }
+
+    const Value* Find(Key key) const
+    {
+        return const_cast<OrderIndex*>(this)->Find(key);
+    }
+
+    // returns false (and leaves the index untouched) if the key is already present
+    bool Insert(Key key, const Value& value)
+    {
+        if ((size_ + 1) * MaxLoadDenominator > slots_.size() * MaxLoadNumerator)
+            Rehash(slots_.size() * 2);
+
+        Slot incoming{ key, value, 1 };
+        auto index = Home(key);
+        bool placed = false;
+
+        for (; ; index = Next(index))
+        {
+            auto& slot = slots_[index];
+            if (slot.distance_ == 0)
+            {
+                slot = incoming;
+                ++size_;
+                return true;
+            }
+
+            // the duplicate check only matters before we start displacing residents
+            if (!placed && slot.key_ == key && slot.distance_ == incoming.distance_)
+                return false;
+
+            if (slot.distance_ < incoming.distance_)
+            {
+                std::swap(slot, incoming);
+                placed = true;
+            }
+
+            ++incoming.distance_;
+        }
+    }
+
+    // removes key and hands back its value; false if it was not present
+    bool Extract(Key key, Value& value)
+    {
+        auto index = Home(key);
+        for (std::uint32_t distance = 1; ; ++distance, index = Next(index))
+        {
+            auto& slot = slots_[index];
+            if (slot.distance_ < distance)
+                return false;
+            if (slot.key_ == key)
+                break;
+        }
+
+        value = slots_[index].value_;
+
+        // backward shift: pull the following run one slot closer to home
+        for (auto next = Next(index); slots_[next].distance_ > 1; index = next, next = Next(next))
+        {
+            slots_[index] = slots_[next];
+            --slots_[index].distance_;
+        }
+
+        slots_[index].distance_ = 0;
+        --size_;
+        return true;
+    }
+
+    bool Erase(Key key)
+    {
+        Value value;
+        return Extract(key, value);
+    }
+
+private:
+    // keep the table at most 7/8 full, Robin Hood probes stay short well past that
+    static constexpr std::size_t MaxLoadNumerator = 7;
+    static constexpr std::size_t MaxLoadDenominator = 8;
+
+    struct Slot
+    {
+        Key key_{ };
+        Value value_{ };
+        std::uint32_t distance_{ 0 }; // probe distance + 1, 0 marks an empty slot
+    };
+
+    std::size_t Home(Key key) const
+    {
+        // fibonacci hashing spreads sequential order ids over the whole table
+        return static_cast<std::size_t>((static_cast<std::uint64_t>(key) * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+    std::size_t Next(std::size_t index) const { return (index + 1) & (slots_.size() - 1); }
+
+    void Rehash(std::size_t capacity)
+    {
+        std::vector<Slot> old(capacity);
+        old.swap(slots_);
+
+        shift_ = 64;
+        for (auto bits = capacity; bits > 1; bits >>= 1)
+            --shift_;
+
+        size_ = 0;
+        for (const auto& slot : old)
+        {
+            if (slot.distance_ != 0)
+                Insert(slot.key_, slot.value_);
+        }
+    }
+
+    std::vector<Slot> slots_;
+    std::size_t size_{ 0 };
+    unsigned shift_{ 64 };
+};
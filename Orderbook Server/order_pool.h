@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Handles are plain 32-bit slot numbers so they can be stored in intrusive links and
+// index entries instead of pointers.
+using PoolHandle = std::uint32_t;
+inline constexpr PoolHandle InvalidPoolHandle = std::numeric_limits<PoolHandle>::max();
+
+// Slab allocated object pool with a free list. Slots never move once a slab is
+// allocated, and freed slots are reused LIFO so the hot ones stay in cache. After the
+// pool has grown to the working set, Allocate/Free never touch the heap.
+//
+// A capture freezes the pool's contents so another thread can read them while the owner
+// keeps going. It is copy-on-write in chunks of CaptureChunkSize objects: the owner's first
+// non-const access to a chunk that existed when the capture began copies the chunk aside
+// before anything in it can change, and the reader copies each chunk it visits the same way,
+// so every chunk is copied at most once, by whichever side gets there first. The owner never
+// waits longer than one small chunk copy, and outside a capture the only cost is one relaxed
+// load per non-const access.
+template <typename T, std::size_t SlabBits = 12>
+class SlabPool
+{
+public:
+    static constexpr std::size_t SlabSize = std::size_t{ 1 } << SlabBits;
+    static constexpr std::size_t CaptureChunkBits = SlabBits < 8 ? SlabBits : 8;
+    static constexpr std::size_t CaptureChunkSize = std::size_t{ 1 } << CaptureChunkBits;
+
+    explicit SlabPool(std::size_t initialCapacity = SlabSize)
+    {
+        while (Capacity() < initialCapacity)
+            AddSlab();
+    }
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    // adds slabs until capacity objects fit, sizing the free list once instead of per slab
+    void Reserve(std::size_t capacity)
+    {
+        if (Capacity() >= capacity)
+            return;
+
+        free_.reserve(capacity + SlabSize);
+        while (Capacity() < capacity)
+            AddSlab();
+    }
+
+    PoolHandle Allocate()
+    {
+        if (free_.empty())
+            AddSlab();
+
+        const auto handle = free_.back();
+        free_.pop_back();
+        ++size_;
+        return handle;
+    }
+
+    void Free(PoolHandle handle)
+    {
+        free_.push_back(handle);
+        --size_;
+    }
+
+    T& operator[](PoolHandle handle)
+    {
+        if (capturing_.load(std::memory_order_relaxed) && (handle >> CaptureChunkBits) < captureChunks_)
+            RecordStall(Preserve(handle >> CaptureChunkBits));
+        return slabs_[handle >> SlabBits][handle & (SlabSize - 1)];
+    }
+
+    const T& operator[](PoolHandle handle) const { return slabs_[handle >> SlabBits][handle & (SlabSize - 1)]; }
+
+    std::size_t Size() const { return size_; }
+    std::size_t Capacity() const { return slabs_.size() * SlabSize; }
+
+    // owner: freezes the pool as it is now; false while the previous capture has not ended
+    bool BeginCapture()
+    {
+        if (capturing_.load(std::memory_order_acquire))
+            return false;
+
+        captureChunks_ = Capacity() / CaptureChunkSize;
+        captureSources_.resize(captureChunks_);
+        for (std::size_t chunk = 0; chunk < captureChunks_; ++chunk)
+            captureSources_[chunk] = &slabs_[(chunk * CaptureChunkSize) >> SlabBits][(chunk * CaptureChunkSize) & (SlabSize - 1)];
+        captureCopies_.clear();
+        captureCopies_.resize(captureChunks_);
+        captureStates_ = std::make_unique<std::atomic<std::uint8_t>[]>(captureChunks_);
+        captureStall_.store(0, std::memory_order_relaxed);
+        captureLongestStall_.store(0, std::memory_order_relaxed);
+
+        capturing_.store(true, std::memory_order_release);
+        return true;
+    }
+
+    // reader: the object as it was when the capture began; handle must have been allocated by then
+    const T& Captured(PoolHandle handle)
+    {
+        const auto chunk = handle >> CaptureChunkBits;
+        Preserve(chunk);
+        return captureCopies_[chunk][handle & (CaptureChunkSize - 1)];
+    }
+
+    // reader: ends the capture and releases the copies. Chunks nobody copied are marked done without a copy
+    void EndCapture()
+    {
+        for (std::size_t chunk = 0; chunk < captureChunks_; ++chunk)
+        {
+            auto expected = Pending;
+            if (!captureStates_[chunk].compare_exchange_strong(expected, Copied, std::memory_order_acq_rel))
+            {
+                while (captureStates_[chunk].load(std::memory_order_acquire) != Copied)
+                    std::this_thread::yield();
+            }
+        }
+
+        // the owner only touches the copies of chunks still pending, and none are left
+        captureCopies_.clear();
+        capturing_.store(false, std::memory_order_release);
+    }
+
+    // time the owner spent copying chunks, or waiting for the reader to finish one, during the current or last
+    // capture, in total and the longest single stop. Any thread; a stop the owner is still in shows up once it ends
+    std::chrono::nanoseconds CaptureStall() const { return std::chrono::nanoseconds{ captureStall_.load(std::memory_order_relaxed) }; }
+    std::chrono::nanoseconds LongestCaptureStall() const { return std::chrono::nanoseconds{ captureLongestStall_.load(std::memory_order_relaxed) }; }
+
+private:
+    void AddSlab()
+    {
+        const auto first = static_cast<PoolHandle>(Capacity());
+        slabs_.push_back(std::make_unique<T[]>(SlabSize));
+
+        // the free list is sized for the whole pool, so Free never reallocates it
+        free_.reserve(Capacity());
+        for (auto slot = SlabSize; slot > 0; --slot)
+            free_.push_back(first + static_cast<PoolHandle>(slot - 1));
+    }
+
+    // per chunk capture state
+    static constexpr std::uint8_t Pending = 0;
+    static constexpr std::uint8_t Copying = 1;
+    static constexpr std::uint8_t Copied = 2;
+
+    // copies the chunk aside unless someone already has; waits if the other side is copying it right now.
+    // Returns how long that took, zero when the chunk was already copied
+    std::chrono::nanoseconds Preserve(std::size_t chunk)
+    {
+        auto& state = captureStates_[chunk];
+        if (state.load(std::memory_order_acquire) == Copied)
+            return std::chrono::nanoseconds{ 0 };
+
+        const auto started = std::chrono::steady_clock::now();
+        auto expected = Pending;
+        if (state.compare_exchange_strong(expected, Copying, std::memory_order_acquire))
+        {
+            captureCopies_[chunk] = std::make_unique<T[]>(CaptureChunkSize);
+            std::copy(captureSources_[chunk], captureSources_[chunk] + CaptureChunkSize, captureCopies_[chunk].get());
+            state.store(Copied, std::memory_order_release);
+        }
+        else
+        {
+            while (state.load(std::memory_order_acquire) != Copied)
+                std::this_thread::yield();
+        }
+
+        return std::chrono::steady_clock::now() - started;
+    }
+
+    // owner only, so plain loads and stores are enough; the counters are atomic because the reader polls them
+    void RecordStall(std::chrono::nanoseconds stopped)
+    {
+        if (stopped.count() == 0)
+            return;
+
+        captureStall_.store(captureStall_.load(std::memory_order_relaxed) + stopped.count(), std::memory_order_relaxed);
+        if (stopped.count() > captureLongestStall_.load(std::memory_order_relaxed))
+            captureLongestStall_.store(stopped.count(), std::memory_order_relaxed);
+    }
+
+    std::vector<std::unique_ptr<T[]>> slabs_;
+    std::vector<PoolHandle> free_;
+    std::size_t size_{ 0 };
+
+    // capture state. captureSources_ keeps the chunk addresses of the moment the capture began, so the
+    // reader never looks at slabs_, which the owner may grow meanwhile
+    std::atomic<bool> capturing_{ false };
+    std::size_t captureChunks_{ 0 };
+    std::vector<T*> captureSources_;
+    std::vector<std::unique_ptr<T[]>> captureCopies_;
+    std::unique_ptr<std::atomic<std::uint8_t>[]> captureStates_;
+    std::atomic<std::chrono::nanoseconds::rep> captureStall_{ 0 };
+    std::atomic<std::chrono::nanoseconds::rep> captureLongestStall_{ 0 };
+};
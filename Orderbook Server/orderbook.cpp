@@ -1,3 +1,5 @@
+#pragma once
+
 #include <iostream>
 #include <map>
 #include <set>
@@ -27,13 +29,27 @@
 #include <thread>
 #include <condition_variable>
 #include <mutex>
+#include <array>
+#include <type_traits>
 
+#include "price_ladder.h"
+#include "order_pool.h"
+#include "order_index.h"
+#include "timer_wheel.h"
+#include "allocation_policy.h"
+#include "auction.h"
 
 
 enum class OrderType
 {
-    GoodTillCancel,  // holds till user says no and cancels the damn order
-    FillandKill // completely execute the entire order immediately (fill) or cancel the entire order (kill) if it cannot be filled immediately. (have time constrains)
+    GoodTillCancel = 0,  // holds till user says no and cancels the damn order
+    FillandKill = 1, // execute whatever can be filled immediately and cancel the rest, never rests in the book
+    FillOrKill = 2, // execute the entire order immediately or reject it without touching the book
+    GoodForDay = 3, // rests like GoodTillCancel until the session close it was given as expiry
+    Market = 4, // no price: sweep the other side until filled or the side is empty, cancel the rest
+    GoodTillDate = 5, // rests like GoodTillCancel until its own expiry time
+    Stop = 6, // waits off book until a trade reaches its stop price, then goes in as a Market order
+    StopLimit = 7, // waits off book until a trade reaches its stop price, then goes in as a GoodTillCancel limit order
 };
 
 enum class Side
@@ -42,10 +58,26 @@ enum class Side
     Sell
 };
 
+// the four order queues of a book, in the order Orderbook::ForEachLevel walks them
+enum class BookQueue : std::uint8_t
+{
+    Bids = 0,
+    Asks = 1,
+    BuyStops = 2,
+    SellStops = 3,
+};
+
 
 using Price = std::int32_t;
 using Quantity = std::uint32_t;
 using OrderID = std::uint64_t; // string here?
+using OrderHandle = PoolHandle; // slot of an order in the Orderbook's pool
+using Timestamp = std::uint64_t; // unix seconds, 0 for orders that never expire
+
+struct Constants
+{
+    static constexpr Price InvalidPrice = std::numeric_limits<Price>::min(); // price of a market order
+};
 
 struct LevelInfo
 {
@@ -71,12 +103,77 @@ private:
     LevelInfos asks_;
 };
 
+// top of book snapshot with a fixed capacity, filled without touching the heap
+struct OrderbookDepth
+{
+    static constexpr std::size_t MaxLevels = 32;
+
+    std::array<LevelInfo, MaxLevels> bids_{ };
+    std::array<LevelInfo, MaxLevels> asks_{ };
+    std::size_t bidCount_{ };
+    std::size_t askCount_{ };
+};
+
+// best levels per side in one small trivial block, cheap enough to publish after every mutation. It has no
+// member initializers so SeqLock can copy it as raw words; value-initialize it (TopOfBook top{ }) for an empty book.
+// bids_[0]/asks_[0] are the best bid/ask when the counts are non-zero
+struct TopOfBook
+{
+    static constexpr std::size_t MaxLevels = 10;
+
+    std::array<LevelInfo, MaxLevels> bids_;
+    std::array<LevelInfo, MaxLevels> asks_;
+    std::uint32_t bidCount_;
+    std::uint32_t askCount_;
+};
+
+// what BasicOrderbook::BeginCapture freezes for a background snapshot: the book-wide state and where each
+// level's queue starts. The orders themselves are kept copy-on-write in the book's pool
+struct BookCapture
+{
+    struct Level
+    {
+        BookQueue queue_;
+        Price price_;
+        Quantity count_;
+        OrderHandle head_;
+        OrderHandle top_;   // the level's top order, under a policy that tracks one
+    };
+
+    std::vector<Level> levels_;
+    std::size_t orderCount_{ };
+    Timestamp clock_{ };
+    Price tickSize_{ };
+    Price lastTradePrice_{ };
+    bool inAuction_{ };
+};
+
 class Order
 {
 public:
-    Order(OrderType orderType, OrderID orderID, Side side, Price price, Quantity quantity)
+    Order() = default;
+
+    // displayQuantity makes an iceberg: only that much of the order shows in the book at a time. 0 shows all of it.
+    // stopPrice is only used by Stop/StopLimit orders
+    Order(OrderType orderType, OrderID orderID, Side side, Price price, Quantity quantity, Timestamp expiry = 0, Quantity displayQuantity = 0,
+        Price stopPrice = Constants::InvalidPrice)
         : orderType_{ orderType }, orderID_{ orderID }, side_{ side },
-        price_{ price }, initialQuantity_{ quantity }, remainingQuantity_{ quantity } {}
+        price_{ price }, initialQuantity_{ quantity }, remainingQuantity_{ quantity }, expiry_{ expiry },
+        displayQuantity_{ displayQuantity }, visibleQuantity_{ displayQuantity != 0 ? std::min(displayQuantity, quantity) : quantity },
+        stopPrice_{ stopPrice } {}
+
+    Order(OrderID orderID, Side side, Quantity quantity)
+        : Order(OrderType::Market, orderID, side, Constants::InvalidPrice, quantity)
+    { }
+
+    // an order part way through its life, e.g. read back from a snapshot: remaining of initialQuantity is
+    // still open and visibleQuantity of that is showing
+    Order(OrderType orderType, OrderID orderID, Side side, Price price, Quantity initialQuantity, Quantity remainingQuantity,
+        Quantity visibleQuantity, Timestamp expiry, Quantity displayQuantity, Price stopPrice)
+        : orderType_{ orderType }, orderID_{ orderID }, side_{ side },
+        price_{ price }, initialQuantity_{ initialQuantity }, remainingQuantity_{ remainingQuantity }, expiry_{ expiry },
+        displayQuantity_{ displayQuantity }, visibleQuantity_{ visibleQuantity },
+        stopPrice_{ stopPrice } {}
 
     OrderType GetOrderType() const { return orderType_; }
     OrderID GetOrderID() const { return orderID_; }
@@ -85,6 +182,13 @@ public:
     Quantity GetInitialQuantity() const { return initialQuantity_; }
     Quantity GetRemainingQuantity() const { return remainingQuantity_; }
     Quantity GetFilledQuantity() const { return GetInitialQuantity() - GetRemainingQuantity(); }
+    Timestamp GetExpiry() const { return expiry_; }
+    Price GetStopPrice() const { return stopPrice_; }
+    bool IsStop() const { return orderType_ == OrderType::Stop || orderType_ == OrderType::StopLimit; }
+    Quantity GetDisplayQuantity() const { return displayQuantity_; }
+    Quantity GetVisibleQuantity() const { return visibleQuantity_; }
+    Quantity GetHiddenQuantity() const { return GetRemainingQuantity() - GetVisibleQuantity(); }
+    bool IsIceberg() const { return displayQuantity_ != 0; }
     bool isFilled() const { return  GetRemainingQuantity() == false; }
     void Fill(Quantity quantity)
     {
@@ -95,21 +199,76 @@ public:
             throw std::logic_error(oss.str());
         }
 
+        // a resting order only ever trades its visible tranche; an incoming iceberg trades through
+        // it and gets a fresh tranche once it rests
+        remainingQuantity_ -= quantity;
+        visibleQuantity_ -= std::min(quantity, visibleQuantity_);
+    }
+
+    // what a stop turns into once it triggers
+    Order ToTriggered() const
+    {
+        if (orderType_ == OrderType::Stop)
+            return Order{ orderID_, side_, remainingQuantity_ };
+
+        return Order{ OrderType::GoodTillCancel, orderID_, side_, price_, remainingQuantity_, 0, displayQuantity_ };
+    }
+
+    // shows the next tranche of an iceberg from its hidden quantity, or the whole remainder of a plain order
+    Quantity Replenish()
+    {
+        visibleQuantity_ = IsIceberg() ? std::min(displayQuantity_, remainingQuantity_) : remainingQuantity_;
+        return visibleQuantity_;
+    }
+
+    // amend down: takes quantity off the open remainder without counting it as filled
+    void Reduce(Quantity quantity)
+    {
+        if (quantity > GetRemainingQuantity())
+        {
+            std::ostringstream oss;
+            oss << "Order (" << GetOrderID() << ") cannot be reduced by more than its remainder quantity.";
+            throw std::logic_error(oss.str());
+        }
+
+        // hidden quantity goes first, the visible tranche only shrinks once nothing is hidden
+        initialQuantity_ -= quantity;
         remainingQuantity_ -= quantity;
+        visibleQuantity_ = std::min(visibleQuantity_, remainingQuantity_);
     }
 
+    // intrusive links to the neighbours in the price level queue, so resting orders need no list nodes
+    OrderHandle GetPrev() const { return prev_; }
+    OrderHandle GetNext() const { return next_; }
+    void SetPrev(OrderHandle prev) { prev_ = prev; }
+    void SetNext(OrderHandle next) { next_ = next; }
+
+    // intrusive links for the expiry timer wheel, only used while a GoodForDay/GoodTillDate order rests
+    OrderHandle GetTimerPrev() const { return timerPrev_; }
+    OrderHandle GetTimerNext() const { return timerNext_; }
+    TimerSlot GetTimerSlot() const { return timerSlot_; }
+    void SetTimerPrev(OrderHandle prev) { timerPrev_ = prev; }
+    void SetTimerNext(OrderHandle next) { timerNext_ = next; }
+    void SetTimerSlot(TimerSlot slot) { timerSlot_ = slot; }
+
 private:
-    OrderType orderType_;
-    OrderID orderID_;
-    Side side_;
-    Price price_;
-    Quantity initialQuantity_;
-    Quantity remainingQuantity_;
+    OrderType orderType_{ OrderType::GoodTillCancel };
+    OrderID orderID_{ };
+    Side side_{ Side::Buy };
+    Price price_{ };
+    Quantity initialQuantity_{ };
+    Quantity remainingQuantity_{ };
+    Timestamp expiry_{ };
+    Quantity displayQuantity_{ };
+    Quantity visibleQuantity_{ };
+    Price stopPrice_{ Constants::InvalidPrice };
+    OrderHandle prev_{ InvalidPoolHandle };
+    OrderHandle next_{ InvalidPoolHandle };
+    OrderHandle timerPrev_{ InvalidPoolHandle };
+    OrderHandle timerNext_{ InvalidPoolHandle };
+    TimerSlot timerSlot_{ InvalidTimerSlot };
 };
 
-using OrderPointer = std::shared_ptr<Order>;
-using OrderPointers = std::list<OrderPointer>;
-
 class OrderModify
 {
 public:
@@ -125,9 +284,9 @@ public:
     Price GetPrice() const { return price_; }
     Quantity GetQuantity() const { return quantity_; }
 
-    OrderPointer ToOrderPointer(OrderType type) const
+    Order ToOrder(OrderType type, Timestamp expiry = 0, Quantity displayQuantity = 0, Price stopPrice = Constants::InvalidPrice) const
     {
-        return std::make_shared<Order>(type, GetOrderID(), GetSide(), GetPrice(), GetQuantity());
+        return Order{ type, GetOrderID(), GetSide(), GetPrice(), GetQuantity(), expiry, displayQuantity, stopPrice };
     }
 
 private:
@@ -166,230 +325,1078 @@ private:
 
 using Trades = std::vector<Trade>;
 
-class Orderbook
+// everything the matching and cancel paths need to know about a side, fixed at compile time so
+// each path is written once and instantiated per side with no side branches left inside
+template <Side S>
+struct SideTraits;
+
+template <>
+struct SideTraits<Side::Buy>
+{
+    using Compare = std::greater<Price>; // best bid is the highest price
+    using StopCompare = std::less<Price>; // buy stops trigger from the lowest stop price up
+    static constexpr Side Opposite = Side::Sell;
+
+    // a buy limit crosses any ask at or below it
+    static bool Crosses(Price limit, Price resting) { return resting <= limit; }
+
+    // a buy stop triggers once a trade prints at or above it
+    static bool Triggers(Price stop, Price lastTrade) { return lastTrade >= stop; }
+};
+
+template <>
+struct SideTraits<Side::Sell>
+{
+    using Compare = std::less<Price>; // best ask is the lowest price
+    using StopCompare = std::greater<Price>; // sell stops trigger from the highest stop price down
+    static constexpr Side Opposite = Side::Buy;
+
+    // a sell limit crosses any bid at or above it
+    static bool Crosses(Price limit, Price resting) { return resting >= limit; }
+
+    // a sell stop triggers once a trade prints at or below it
+    static bool Triggers(Price stop, Price lastTrade) { return lastTrade <= stop; }
+};
+
+// Allocation picks how an aggressor is split across the orders of a level, see allocation_policy.h
+template <typename Allocation = FifoAllocation>
+class BasicOrderbook
 {
 private:
-    //using a map for bids (in descending from best bid ) and ask (ascending for best ask) we can have O(N) access . 
-    // order iterator for its location 
+    //bids and asks sit on dense price ladders (descending from best bid, ascending from best ask) so level insert and lookup are O(1).
+    //orders live in a slab pool owned by the book and are chained into their level through intrusive links.
+    //orders_ maps an id to its pool slot in a flat open addressing table, one probe per lookup.
+    //expiries_ holds only the resting GoodForDay/GoodTillDate orders, so expiry never scans the book.
+    //untriggered stops sit in per-side trigger ladders keyed by stop price, ordered so the next stop to trigger is
+    //always the best level, so a trade only ever looks at the stops it actually triggers.
     struct OrderEntry
     {
-        OrderPointer order_{ nullptr };
-        OrderPointers::iterator location_;
+        OrderHandle handle_{ InvalidPoolHandle };
+    };
 
+    // the level's top order, only kept when the allocation policy gives it priority, so FIFO levels stay as small as before
+    struct TopOrderSlot
+    {
+        OrderHandle top_{ InvalidPoolHandle };
+    };
+
+    struct NoTopOrderSlot
+    {
     };
 
+    // FIFO queue of the orders resting at one price, plus running totals so depth queries never walk the queue.
+    // quantity_ is what the level displays; hidden_ is the iceberg reserve behind it, which still trades
+    struct PriceLevel : std::conditional_t<Allocation::TracksTopOrder, TopOrderSlot, NoTopOrderSlot>
+    {
+        OrderHandle head_{ InvalidPoolHandle };
+        OrderHandle tail_{ InvalidPoolHandle };
+        Quantity quantity_{ };
+        Quantity hidden_{ };
+        Quantity count_{ };
+
+        enum class Action
+        {
+            Add,
+            Remove,
+            Match,
+            Replenish,
+        };
+
+        bool empty() const { return head_ == InvalidPoolHandle; }
+    };
+
+
+    SlabPool<Order> orderPool_;
+    TimerWheel<SlabPool<Order>> expiries_;
+    template <Side S>
+    using Ladder = PriceLadder<Price, PriceLevel, typename SideTraits<S>::Compare>;
+
+    Ladder<Side::Buy> bids_;
+    Ladder<Side::Sell> asks_;
+    OrderIndex<OrderID, OrderEntry> orders_;
+
+    template <Side S>
+    using StopLadder = PriceLadder<Price, PriceLevel, typename SideTraits<S>::StopCompare>;
+
+    StopLadder<Side::Buy> buyStops_;
+    StopLadder<Side::Sell> sellStops_;
+    Price lastTradePrice_{ Constants::InvalidPrice }; // no stop triggers before the first trade
+
+    // during an auction call phase orders only rest, the book may cross, and nothing trades until Uncross
+    bool inAuction_{ false };
+    AuctionCurves auctionCurves_;
+
+    // scratch for non-sequential allocation policies: one level's queue gathered in time priority.
+    // reused across matches, so it stops allocating once it has seen the deepest level
+    std::vector<OrderHandle> allocationHandles_;
+    std::vector<Quantity> allocationResting_;
+    std::vector<Quantity> allocationFills_;
+    std::vector<std::uint32_t> allocationRanks_;
+
+    // what each side's orders got in an uncross under a non-sequential policy, in the order allocated
+    struct AuctionFill
+    {
+        OrderID orderID_;
+        Quantity quantity_;
+    };
+
+    std::vector<AuctionFill> auctionBuys_;
+    std::vector<AuctionFill> auctionSells_;
+
+    template <Side S>
+    Ladder<S>& LadderOf()
+    {
+        if constexpr (S == Side::Buy)
+            return bids_;
+        else
+            return asks_;
+    }
+
+    template <Side S>
+    const Ladder<S>& LadderOf() const
+    {
+        if constexpr (S == Side::Buy)
+            return bids_;
+        else
+            return asks_;
+    }
+
+    template <Side S>
+    StopLadder<S>& StopsOf()
+    {
+        if constexpr (S == Side::Buy)
+            return buyStops_;
+        else
+            return sellStops_;
+    }
+
+    void PushBack(PriceLevel& level, OrderHandle handle)
+    {
+        auto& order = orderPool_[handle];
+        order.SetPrev(level.tail_);
+        order.SetNext(InvalidPoolHandle);
+
+        if (level.empty())
+            level.head_ = handle;
+        else
+            orderPool_[level.tail_].SetNext(handle);
+
+        level.tail_ = handle;
+    }
+
+    static OrderHandle TopOrderOf(const PriceLevel& level)
+    {
+        if constexpr (Allocation::TracksTopOrder)
+            return level.top_;
+        else
+            return InvalidPoolHandle;
+    }
+
+    template <typename OrderVisitor>
+    static void VisitOrder(OrderVisitor& orderVisitor, const Order& order, bool topOrder)
+    {
+        if constexpr (std::is_invocable_v<OrderVisitor&, const Order&, bool>)
+            orderVisitor(order, topOrder);
+        else
+            orderVisitor(order);
+    }
+
+    // an order leaving its level for good stops being the level's top order, and nobody inherits the status
+    static void ClearTopOrder(PriceLevel& level, OrderHandle handle)
+    {
+        if constexpr (Allocation::TracksTopOrder)
+        {
+            if (level.top_ == handle)
+                level.top_ = InvalidPoolHandle;
+        }
+    }
+
+    void Unlink(PriceLevel& level, OrderHandle handle)
+    {
+        const auto& order = orderPool_[handle];
+
+        if (order.GetPrev() == InvalidPoolHandle)
+            level.head_ = order.GetNext();
+        else
+            orderPool_[order.GetPrev()].SetNext(order.GetNext());
+
+        if (order.GetNext() == InvalidPoolHandle)
+            level.tail_ = order.GetPrev();
+        else
+            orderPool_[order.GetNext()].SetPrev(order.GetPrev());
+    }
+
+    // keeps quantity_/hidden_/count_ in step with the queue: Add and Remove move a whole order in or out, Match takes
+    // quantity off an order that stays queued (a partial fill or an amend down), Replenish shows hidden quantity
+    static void UpdateLevelData(PriceLevel& level, Quantity quantity, PriceLevel::Action action, Quantity hidden = 0)
+    {
+        switch (action)
+        {
+        case PriceLevel::Action::Add:
+            level.quantity_ += quantity;
+            level.hidden_ += hidden;
+            ++level.count_;
+            break;
+        case PriceLevel::Action::Remove:
+            level.quantity_ -= quantity;
+            level.hidden_ -= hidden;
+            --level.count_;
+            break;
+        case PriceLevel::Action::Match:
+            level.quantity_ -= quantity;
+            level.hidden_ -= hidden;
+            break;
+        case PriceLevel::Action::Replenish:
+            level.quantity_ += quantity;
+            level.hidden_ -= quantity;
+            break;
+        }
+    }
+
+    static bool Rests(OrderType type)
+    {
+        return type == OrderType::GoodTillCancel || type == OrderType::GoodForDay || type == OrderType::GoodTillDate;
+    }
+
+    static bool Expires(OrderType type)
+    {
+        return type == OrderType::GoodForDay || type == OrderType::GoodTillDate;
+    }
+
+    // takes a resting order out of its level and releases its slot; the caller has already dropped it from orders_ and expiries_
+    template <Side S>
+    void RemoveOrder(OrderHandle handle)
+    {
+        const auto& order = orderPool_[handle];
+        auto price = order.GetPrice();
+        auto& ladder = LadderOf<S>();
+
+        auto& orders = *ladder.Find(price);
+        Unlink(orders, handle);
+        ClearTopOrder(orders, handle);
+        UpdateLevelData(orders, order.GetVisibleQuantity(), PriceLevel::Action::Remove, order.GetHiddenQuantity());
+        if (orders.empty())
+        {
+            ladder.Erase(price);
+        }
+
+        orderPool_.Free(handle);
+    }
+
+    // takes an untriggered stop out of its trigger level and releases its slot; the caller has already dropped it from orders_
+    template <Side S>
+    void RemoveStop(OrderHandle handle)
+    {
+        const auto& order = orderPool_[handle];
+        auto price = order.GetStopPrice();
+        auto& stops = StopsOf<S>();
+
+        auto& level = *stops.Find(price);
+        Unlink(level, handle);
+        UpdateLevelData(level, order.GetRemainingQuantity(), PriceLevel::Action::Remove);
+        if (level.empty())
+        {
+            stops.Erase(price);
+        }
 
-    std::map<Price, OrderPointers, std::greater<Price>> bids_;
-    std::map<Price, OrderPointers, std::less<Price>> asks_;
-    std::unordered_map<OrderID, OrderEntry> orders_;
+        orderPool_.Free(handle);
+    }
+
+    void RemoveOrder(OrderHandle handle)
+    {
+        const auto& order = orderPool_[handle];
+        if (order.IsStop())
+        {
+            if (order.GetSide() == Side::Buy)
+                RemoveStop<Side::Buy>(handle);
+            else
+                RemoveStop<Side::Sell>(handle);
+        }
+        else if (order.GetSide() == Side::Buy)
+            RemoveOrder<Side::Buy>(handle);
+        else
+            RemoveOrder<Side::Sell>(handle);
+    }
+
+    // walks the opposite side's level totals up to the limit price, never the orders inside them.
+    // hidden iceberg quantity counts, the aggressor trades through it
+    template <Side S>
+    bool CanFullyFill(Price price, Quantity quantity) const
+    {
+        if (!CanMatch<S>(price))
+            return false;
+
+        // counted in 64 bits: a level's shown and hidden quantity together can be more than a Quantity holds
+        std::uint64_t needed = quantity;
+        bool canFill = false;
+        LadderOf<SideTraits<S>::Opposite>().ForEachWhile([&](Price levelPrice, const PriceLevel& level)
+            {
+                if (!SideTraits<S>::Crosses(price, levelPrice))
+                    return false;
+
+                const auto available = std::uint64_t{ level.quantity_ } + level.hidden_;
+                if (available >= needed)
+                {
+                    canFill = true;
+                    return false;
+                }
+
+                needed -= available;
+                return true;
+            });
+
+        return canFill;
+    }
 
     //match methods
     // so we add an order, if its not f&k we add to the list, else if it doesnt match , we discard instantly
 
-    bool CanMatch(Side side, Price price) const
+    template <Side S>
+    bool CanMatch(Price price) const
     {
-        if (side == Side::Buy)
+        const auto& opposite = LadderOf<SideTraits<S>::Opposite>();
+        return !opposite.Empty() && SideTraits<S>::Crosses(price, opposite.BestPrice());
+    }
+
+    // takes quantity (at most its visible tranche) off a resting order, releasing the order once it is done
+    void FillResting(PriceLevel& level, OrderHandle handle, Quantity quantity)
+    {
+        auto& resting = orderPool_[handle];
+        resting.Fill(quantity);
+
+        UpdateLevelData(level, quantity, resting.isFilled() ? PriceLevel::Action::Remove : PriceLevel::Action::Match);
+
+        if (resting.isFilled())
         {
-            if (asks_.empty())
-                return false;
+            Unlink(level, handle);
+            ClearTopOrder(level, handle);
+            orders_.Erase(resting.GetOrderID());
+            expiries_.Remove(handle);
+            orderPool_.Free(handle);
+        }
+        else if (resting.GetVisibleQuantity() == 0)
+        {
+            // an iceberg whose tranche is used up shows the next one and goes to the back of the queue:
+            // two link updates, no cancel/add and nothing reallocated
+            UpdateLevelData(level, resting.Replenish(), PriceLevel::Action::Replenish);
+            Unlink(level, handle);
+            PushBack(level, handle);
+        }
+    }
+
+    // trades quantity between the incoming order and one resting order
+    template <Side S, typename TradeSink>
+    void Fill(Order& incoming, PriceLevel& level, OrderHandle handle, Quantity quantity, TradeSink& sink)
+    {
+        const auto& resting = orderPool_[handle];
+        lastTradePrice_ = resting.GetPrice();
+
+        incoming.Fill(quantity);
+
+        // market orders carry no price and trade at the resting one
+        const auto incomingPrice = incoming.GetOrderType() == OrderType::Market ? resting.GetPrice() : incoming.GetPrice();
+        const TradeInfo incomingTrade{ incoming.GetOrderID(), incomingPrice, quantity };
+        const TradeInfo restingTrade{ resting.GetOrderID(), resting.GetPrice(), quantity };
+        if constexpr (S == Side::Buy)
+            sink(Trade{ incomingTrade, restingTrade });
+        else
+            sink(Trade{ restingTrade, incomingTrade });
+
+        FillResting(level, handle, quantity);
+    }
 
-            const auto& [bestAsk, _] = *asks_.begin();
-            return price >= bestAsk;
+    // hands the incoming order as much of one level as it can take, split the way Allocation says
+    template <Side S, typename TradeSink>
+    void MatchLevel(Order& incoming, PriceLevel& level, TradeSink& sink)
+    {
+        if constexpr (Allocation::Sequential)
+        {
+            while (!incoming.isFilled() && !level.empty())
+                Fill<S>(incoming, level, level.head_, std::min(incoming.GetRemainingQuantity(), orderPool_[level.head_].GetVisibleQuantity()), sink);
         }
         else
         {
-            if (bids_.empty())
-                return false;
+            const auto count = AllocateLevel(level, std::min(incoming.GetRemainingQuantity(), level.quantity_));
 
-            const auto& [bestBid, _] = *bids_.begin();
-            return price <= bestBid;
+            // fills are reported in the order gathered, the top order then time priority, and orders with no share
+            // are left alone. Icebergs replenished here move behind the queue that was gathered and are shared out
+            // on the next pass over the level
+            for (std::size_t index = 0; index < count; ++index)
+            {
+                if (allocationFills_[index] != 0)
+                    Fill<S>(incoming, level, allocationHandles_[index], allocationFills_[index], sink);
+            }
         }
     }
 
-    Trades MatchOrders()
+    // non-sequential policies: gathers the level's queue into allocationHandles_, the top order first, and has
+    // Allocation split quantity (at most the level's visible quantity) over it into allocationFills_.
+    // Returns how many orders were gathered; nothing is filled yet
+    std::size_t AllocateLevel(const PriceLevel& level, Quantity quantity)
     {
-        Trades trades;
-        trades.reserve(orders_.size());
+        allocationHandles_.clear();
+        allocationResting_.clear();
+        auto gather = [this](OrderHandle handle)
+            {
+                allocationHandles_.push_back(handle);
+                allocationResting_.push_back(orderPool_[handle].GetVisibleQuantity());
+            };
+
+        // the top order goes first, wherever it sits in the queue
+        const auto top = TopOrderOf(level);
+        if (top != InvalidPoolHandle)
+            gather(top);
 
-        while (true)
+        for (auto handle = level.head_; handle != InvalidPoolHandle; handle = orderPool_[handle].GetNext())
         {
-            if (bids_.empty() || asks_.empty())
-                break;
+            if (handle != top)
+                gather(handle);
+        }
 
-            auto& [bidPrice, bids] = *bids_.begin();
-            auto& [askPrice, asks] = *asks_.begin();
+        const auto count = allocationHandles_.size();
+        allocationFills_.resize(count);
+        allocationRanks_.resize(count);
+        Allocation::Allocate(quantity, level.quantity_, allocationResting_.data(), allocationFills_.data(), allocationRanks_.data(),
+            count, top != InvalidPoolHandle);
+        return count;
+    }
 
-            if (bidPrice < askPrice)
-                break;
+    // uncross under a non-sequential policy: takes volume off side S best price first, each level split the way
+    // Allocation says, and records who got what in fills
+    template <Side S>
+    void AllocateAuctionSide(std::uint64_t volume, std::vector<AuctionFill>& fills)
+    {
+        auto& ladder = LadderOf<S>();
+        fills.clear();
+        while (volume != 0)
+        {
+            const Price levelPrice = ladder.BestPrice();
+            auto& level = ladder.Best();
 
-            while (!bids.empty() && !asks.empty())
+            // icebergs replenished in one pass are shared out in the next, like in MatchLevel
+            const auto quantity = static_cast<Quantity>(std::min<std::uint64_t>(volume, level.quantity_));
+            const auto count = AllocateLevel(level, quantity);
+            for (std::size_t index = 0; index < count; ++index)
             {
-                auto bid = bids.front();
-                auto ask = asks.front();
+                if (allocationFills_[index] == 0)
+                    continue;
 
-                Quantity quantity = std::min(bid->GetRemainingQuantity(), ask->GetRemainingQuantity());
+                fills.push_back(AuctionFill{ orderPool_[allocationHandles_[index]].GetOrderID(), allocationFills_[index] });
+                FillResting(level, allocationHandles_[index], allocationFills_[index]);
+            }
+            volume -= quantity;
 
-                bid->Fill(quantity);
-                ask->Fill(quantity);
+            if (level.empty())
+                ladder.Erase(levelPrice);
+        }
+    }
 
-                if (bid->isFilled())
-                {
-                    bids.pop_front();
-                    orders_.erase(bid->GetOrderID());
-                }
+    // sweeps the opposite side with the incoming order before it ever touches the book, best level first.
+    // every fill is handed to sink as it happens
+    template <Side S, typename TradeSink>
+    void MatchAggressor(Order& incoming, TradeSink& sink)
+    {
+        auto& opposite = LadderOf<SideTraits<S>::Opposite>();
 
-                if (ask->isFilled())
-                {
-                    asks.pop_front();
-                    orders_.erase(ask->GetOrderID());
-                }
+        // market orders have no limit, they take every level until filled or the side runs dry
+        const bool isMarket = incoming.GetOrderType() == OrderType::Market;
 
+        while (!incoming.isFilled() && !opposite.Empty() && (isMarket || SideTraits<S>::Crosses(incoming.GetPrice(), opposite.BestPrice())))
+        {
+            const Price levelPrice = opposite.BestPrice();
+            auto& level = opposite.Best();
 
-                trades.push_back(Trade{
-                    TradeInfo{ bid->GetOrderID(), bid->GetPrice(), quantity },
-                    TradeInfo{ ask->GetOrderID(), ask->GetPrice(), quantity }
-                    });
+            MatchLevel<S>(incoming, level, sink);
 
+            // drop emptied levels so the ladder moves on to the next best price
+            if (level.empty())
+                opposite.Erase(levelPrice);
+        }
+    }
 
-            }
+    // parks a stop in its side's trigger ladder; it does not touch the order book until it triggers
+    template <Side S>
+    void AddStop(const Order& order)
+    {
+        auto& stops = StopsOf<S>();
+        if (!stops.CanInsert(order.GetStopPrice()))
+            return;
 
+        // a stop-limit has to be able to rest at its limit once it triggers
+        if (order.GetOrderType() == OrderType::StopLimit && !LadderOf<S>().IsOnTick(order.GetPrice()))
+            return;
+
+        const auto handle = orderPool_.Allocate();
+        if (!orders_.Insert(order.GetOrderID(), OrderEntry{ handle }))
+        {
+            orderPool_.Free(handle);
+            return;
+        }
+        orderPool_[handle] = order;
 
+        auto& level = stops.Insert(order.GetStopPrice());
+        PushBack(level, handle);
+        UpdateLevelData(level, order.GetRemainingQuantity(), PriceLevel::Action::Add);
+    }
+
+    // the first stop on side S crossed by the last trade price, InvalidPoolHandle if there is none
+    template <Side S>
+    OrderHandle NextTriggered()
+    {
+        auto& stops = StopsOf<S>();
+        if (stops.Empty() || !SideTraits<S>::Triggers(stops.BestPrice(), lastTradePrice_))
+            return InvalidPoolHandle;
+
+        return stops.Best().head_;
+    }
+
+    // injects every stop the last trade price has crossed, in a fixed order: buy stops before sell stops, the
+    // nearest stop price first and FIFO within a stop price. Trades of an injected stop move the last price and
+    // may trigger more stops, which are picked up by the same loop, so a cascade never recurses.
+    // When nothing has triggered this is two comparisons
+    template <typename TradeSink>
+    void TriggerStops(TradeSink& sink)
+    {
+        // stops wait out an auction call phase, the uncross triggers them
+        if (lastTradePrice_ == Constants::InvalidPrice || inAuction_)
+            return;
+
+        for (;;)
+        {
+            auto handle = NextTriggered<Side::Buy>();
+            if (handle == InvalidPoolHandle)
+                handle = NextTriggered<Side::Sell>();
+            if (handle == InvalidPoolHandle)
+                return;
+
+            const Order triggered = orderPool_[handle].ToTriggered();
+            orders_.Erase(triggered.GetOrderID());
+            RemoveOrder(handle);
+
+            if (triggered.GetSide() == Side::Buy)
+                AddOrder<Side::Buy>(triggered, sink);
+            else
+                AddOrder<Side::Sell>(triggered, sink);
         }
+    }
+
+    // the side-specific half of AddOrder, instantiated once per side
+    template <Side S, typename TradeSink>
+    void AddOrder(const Order& order, TradeSink& sink)
+    {
+        // only orders that can wait for the uncross take part in an auction
+        if (inAuction_ && !Rests(order.GetOrderType()))
+            return;
+
+        if (order.GetOrderType() == OrderType::FillandKill && !CanMatch<S>(order.GetPrice()))
+            return;
 
-        if (!bids_.empty())
+        // a rejected FOK costs one walk over level totals: no book mutation, no allocation
+        if (order.GetOrderType() == OrderType::FillOrKill && !CanFullyFill<S>(order.GetPrice(), order.GetRemainingQuantity()))
+            return;
+
+        // off-tick prices, or resting prices so far away the ladder would have to span more than MaxLevels, are rejected.
+        // market orders carry no price and never rest, so there is nothing to check
+        if (order.GetOrderType() != OrderType::Market)
         {
-            auto& [_, bids] = *bids_.begin();
-            auto& order = bids.front();
-            if (order->GetOrderType() == OrderType::FillandKill)
-                CancelOrder(order->GetOrderID());
+            const bool canRest = LadderOf<S>().CanInsert(order.GetPrice());
+            if (!canRest && (Rests(order.GetOrderType()) || !LadderOf<S>().IsOnTick(order.GetPrice())))
+                return;
         }
 
-        if (!asks_.empty())
+        // an order that would already be expired never trades
+        if (Expires(order.GetOrderType()) && order.GetExpiry() <= expiries_.Now())
+            return;
+
+        if (orders_.Contains(order.GetOrderID()))
+            return;
+
+        // the book is never crossed, so only the incoming order can trade; match it first and
+        // rest whatever is left, so marketable orders never go through the insert-then-erase round trip
+        Order incoming = order;
+        if (!inAuction_)
+            MatchAggressor<S>(incoming, sink);
+
+        if (incoming.isFilled() || !Rests(incoming.GetOrderType()))
+            return;
+
+        // an iceberg rests with a full tranche showing, whatever it traded on the way in
+        incoming.Replenish();
+
+        const auto handle = orderPool_.Allocate();
+        orders_.Insert(incoming.GetOrderID(), OrderEntry{ handle });
+        orderPool_[handle] = incoming;
+
+        auto& ladder = LadderOf<S>();
+
+        // an order that sets the side's best price, on an empty side or by improving on it, always opens its
+        // level and becomes the level's top order
+        bool setsBest = false;
+        if constexpr (Allocation::TracksTopOrder)
+            setsBest = ladder.Empty() || typename SideTraits<S>::Compare{ }(incoming.GetPrice(), ladder.BestPrice());
+
+        auto& level = ladder.Insert(incoming.GetPrice());
+        PushBack(level, handle);
+        UpdateLevelData(level, incoming.GetVisibleQuantity(), PriceLevel::Action::Add, incoming.GetHiddenQuantity());
+
+        if constexpr (Allocation::TracksTopOrder)
         {
-            auto& [_, asks] = *asks_.begin();
-            auto& order = asks.front();
-            if (order->GetOrderType() == OrderType::FillandKill)
-                CancelOrder(order->GetOrderID());
+            if (setsBest)
+                level.top_ = handle;
         }
 
-        return trades;
+        if (Expires(incoming.GetOrderType()))
+            expiries_.Schedule(handle);
     }
 
 public:
-    Trades AddOrder(OrderPointer order)
+    explicit BasicOrderbook(Price tickSize = 1, std::size_t orderCapacity = SlabPool<Order>::SlabSize)
+        : orderPool_{ orderCapacity }
+        , expiries_{ orderPool_ }
+        , bids_{ tickSize }
+        , asks_{ tickSize }
+        , orders_{ orderCapacity }
+        , buyStops_{ tickSize }
+        , sellStops_{ tickSize }
+    { }
+
+    // matching thread: freezes the book as it stands so a background thread can save it while matching goes on.
+    // Costs one pass over the levels, no order is touched; from then on the first write into each slab of the
+    // pool copies that slab aside once. False while the previous capture has not been ended
+    bool BeginCapture(BookCapture& capture)
     {
-        if (orders_.contains(order->GetOrderID()))
-            return { };
+        if (!orderPool_.BeginCapture())
+            return false;
 
+        capture.levels_.clear();
+        auto levels = [&capture](BookQueue queue, const auto& ladder)
+            {
+                ladder.ForEach([&](Price price, const PriceLevel& level)
+                    { capture.levels_.push_back(BookCapture::Level{ queue, price, level.count_, level.head_, TopOrderOf(level) }); });
+            };
 
-        if (order->GetOrderType() == OrderType::FillandKill && !CanMatch(order->GetSide(), order->GetPrice()))
-            return { };
+        levels(BookQueue::Bids, bids_);
+        levels(BookQueue::Asks, asks_);
+        levels(BookQueue::BuyStops, buyStops_);
+        levels(BookQueue::SellStops, sellStops_);
+
+        capture.orderCount_ = orders_.Size();
+        capture.clock_ = expiries_.Now();
+        capture.tickSize_ = bids_.TickSize();
+        capture.lastTradePrice_ = lastTradePrice_;
+        capture.inAuction_ = inAuction_;
+        return true;
+    }
 
+    // any one thread, concurrently with matching: walks the book as it was at BeginCapture, in the same order
+    // and with the same visitors as ForEachLevel
+    template <typename LevelVisitor, typename OrderVisitor>
+    void ForEachCaptured(const BookCapture& capture, LevelVisitor&& levelVisitor, OrderVisitor&& orderVisitor)
+    {
+        for (const auto& level : capture.levels_)
+        {
+            levelVisitor(level.queue_, level.price_, level.count_);
+            for (auto handle = level.head_; handle != InvalidPoolHandle; handle = orderPool_.Captured(handle).GetNext())
+                VisitOrder(orderVisitor, orderPool_.Captured(handle), handle == level.top_);
+        }
+    }
 
+    // the thread that walked the capture: releases it, matching stops paying for copy-on-write
+    void EndCapture()
+    {
+        orderPool_.EndCapture();
+    }
 
-        OrderPointers::iterator iterator;
+    // time the matching thread lost to copy-on-write during the current or last capture, in total and at most at once
+    std::chrono::nanoseconds CaptureStall() const { return orderPool_.CaptureStall(); }
+    std::chrono::nanoseconds LongestCaptureStall() const { return orderPool_.LongestCaptureStall(); }
 
-        if (order->GetSide() == Side::Buy)
+    // sizes an empty book for orderCount orders and puts back the expiry clock, last trade price and auction
+    // state of the book it is being rebuilt from. Orders follow through RestoreOrder
+    void BeginRestore(std::size_t orderCount, Timestamp clock, Price lastTradePrice, bool inAuction)
+    {
+        orderPool_.Reserve(orderCount);
+        orders_.Reserve(orderCount);
+
+        // the wheel is empty, so this only moves its clock
+        expiries_.Advance(clock, [](OrderHandle) { });
+        lastTradePrice_ = lastTradePrice;
+        inAuction_ = inAuction;
+    }
+
+    // bulk load: appends a resting order to the back of its level, or a stop to the back of its trigger level,
+    // without matching or any of AddOrder's checks. Orders must arrive in the time priority they had, and
+    // must not cross the book unless it is in an auction. topOrder makes the order its level's top order again,
+    // under a policy that tracks one. Duplicate ids are dropped
+    void RestoreOrder(const Order& order, bool topOrder = false)
+    {
+        const auto handle = orderPool_.Allocate();
+        if (!orders_.Insert(order.GetOrderID(), OrderEntry{ handle }))
         {
-            auto& orders = bids_[order->GetPrice()];
-            orders.push_back(order);
-            iterator = std::prev(orders.end());
+            orderPool_.Free(handle);
+            return;
         }
+        orderPool_[handle] = order;
+
+        PriceLevel* level = nullptr;
+        if (order.IsStop())
+            level = order.GetSide() == Side::Buy ? &buyStops_.Insert(order.GetStopPrice()) : &sellStops_.Insert(order.GetStopPrice());
+        else
+            level = order.GetSide() == Side::Buy ? &bids_.Insert(order.GetPrice()) : &asks_.Insert(order.GetPrice());
+
+        PushBack(*level, handle);
+        if (order.IsStop())
+            UpdateLevelData(*level, order.GetRemainingQuantity(), PriceLevel::Action::Add);
         else
+            UpdateLevelData(*level, order.GetVisibleQuantity(), PriceLevel::Action::Add, order.GetHiddenQuantity());
+
+        if constexpr (Allocation::TracksTopOrder)
         {
-            auto& orders = asks_[order->GetPrice()];
-            orders.push_back(order);
-            iterator = std::prev(orders.end());
+            if (topOrder && !order.IsStop())
+                level->top_ = handle;
         }
 
-        orders_.insert({ order->GetOrderID(), OrderEntry{ order, iterator } });
+        if (Expires(order.GetOrderType()))
+            expiries_.Schedule(handle);
+    }
+
+    Trades AddOrder(const Order& order)
+    {
+        Trades trades;
+        AddOrder(order, [&trades](const Trade& trade) { trades.push_back(trade); });
+        return trades;
+    }
 
+    // sink is any callable taking const Trade&; it sees each fill straight from the matching loop, including the
+    // fills of any stops the order triggers. The side is dispatched here, once, everything below runs on the
+    // side-specialized path
+    template <typename TradeSink>
+    void AddOrder(const Order& order, TradeSink&& sink)
+    {
+        if (order.IsStop())
+        {
+            if (order.GetSide() == Side::Buy)
+                AddStop<Side::Buy>(order);
+            else
+                AddStop<Side::Sell>(order);
+        }
+        else if (order.GetSide() == Side::Buy)
+            AddOrder<Side::Buy>(order, sink);
+        else
+            AddOrder<Side::Sell>(order, sink);
 
-        return MatchOrders();
+        // a stop that arrives already crossed by the last trade triggers straight away
+        TriggerStops(sink);
     }
 
     void CancelOrder(OrderID orderID)
     {
-        if (!orders_.contains(orderID))
+        OrderEntry entry;
+        if (!orders_.Extract(orderID, entry))
         {
             return;
         }
 
-        const auto& [order, orderIterator] = orders_.at(orderID);
-        orders_.erase(orderID);
+        expiries_.Remove(entry.handle_);
+        RemoveOrder(entry.handle_);
+    }
 
-        if (order->GetSide() == Side::Sell)
-        {
-            auto price = order->GetPrice();
-            auto& orders = asks_.at(price);
-            orders.erase(orderIterator);
-            if (orders.empty())
+    // cancels every GoodForDay/GoodTillDate order with expiry <= now in one batched pass and hands each
+    // one to sink (any callable taking const Order&) before it leaves the book. Only due orders are
+    // touched, each in O(1), so a session close costs the number of expiring orders, not the book size
+    template <typename ExpirySink>
+    std::size_t ExpireOrders(Timestamp now, ExpirySink&& sink)
+    {
+        return expiries_.Advance(now, [&](OrderHandle handle)
             {
-                asks_.erase(price);
-            }
+                const auto& order = orderPool_[handle];
+                sink(order);
+                orders_.Erase(order.GetOrderID());
+                RemoveOrder(handle);
+            });
+    }
+
+    std::size_t ExpireOrders(Timestamp now)
+    {
+        return ExpireOrders(now, [](const Order&) { });
+    }
+
+    Trades MatchOrder(OrderModify order)
+    {
+        Trades trades;
+        MatchOrder(order, [&trades](const Trade& trade) { trades.push_back(trade); });
+        return trades;
+    }
+
+    template <typename TradeSink>
+    void MatchOrder(OrderModify order, TradeSink&& sink)
+    {
+        const auto* entry = orders_.Find(order.GetOrderID());
+        if (entry == nullptr)
+        {
+            return;
         }
-        else
+
+        auto& existing = orderPool_[entry->handle_];
+
+        // a smaller quantity at the same price is amended in place: the order keeps its queue
+        // position and nothing is unlinked, freed or reallocated. Untriggered stops have no queue position to keep
+        if (!existing.IsStop() && order.GetSide() == existing.GetSide() && order.GetPrice() == existing.GetPrice()
+            && order.GetQuantity() != 0 && order.GetQuantity() <= existing.GetRemainingQuantity())
         {
-            auto price = order->GetPrice();
-            auto& orders = bids_.at(price);
-            orders.erase(orderIterator);
-            if (orders.empty())
-            {
-                bids_.erase(price);
-            }
+            const auto reduction = existing.GetRemainingQuantity() - order.GetQuantity();
+            const auto visible = existing.GetVisibleQuantity();
+            auto& level = existing.GetSide() == Side::Buy ? *bids_.Find(existing.GetPrice()) : *asks_.Find(existing.GetPrice());
+            existing.Reduce(reduction);
+            const auto visibleReduction = visible - existing.GetVisibleQuantity();
+            UpdateLevelData(level, visibleReduction, PriceLevel::Action::Match, reduction - visibleReduction);
+            return;
         }
+
+        // a price change or a bigger quantity loses priority and goes through the book again
+        const auto orderType = existing.GetOrderType();
+        const auto expiry = existing.GetExpiry();
+        const auto displayQuantity = existing.GetDisplayQuantity();
+        const auto stopPrice = existing.GetStopPrice();
+        CancelOrder(order.GetOrderID());
+        AddOrder(order.ToOrder(orderType, expiry, displayQuantity, stopPrice), sink);
     }
 
-    Trades MatchOrder(OrderModify order)
+    // starts a call phase: from here on AddOrder only rests GoodTillCancel/GoodForDay/GoodTillDate orders (FillAndKill,
+    // FillOrKill and Market orders are rejected) and nothing matches until Uncross
+    void StartAuction()
+    {
+        inAuction_ = true;
+    }
+
+    bool InAuction() const { return inAuction_; }
+
+    // ends the call phase: every crossing order executes at one clearing price, the one with the most volume
+    // (ties: smallest imbalance, then nearest the last trade, then lowest). Orders are taken best price first,
+    // hidden iceberg quantity included, and each side's share of a price level is split the way Allocation
+    // says, FIFO by default. Returns the clearing price, InvalidPrice if nothing crossed. The book is back to
+    // continuous matching afterwards and uncrossed
+    template <typename TradeSink>
+    Price Uncross(TradeSink&& sink)
     {
-        if (!orders_.contains(order.GetOrderID()))
+        inAuction_ = false;
+        if (bids_.Empty() || asks_.Empty() || bids_.BestPrice() < asks_.BestPrice())
+            return Constants::InvalidPrice;
+
+        // the curves only need the crossed range; outside it one side is empty and nothing can trade
+        const Price tick = bids_.TickSize();
+        const Price low = asks_.BestPrice();
+        const Price high = bids_.BestPrice();
+        auctionCurves_.Reset(static_cast<std::size_t>((static_cast<std::int64_t>(high) - low) / tick) + 1);
+
+        auto indexOf = [low, tick](Price price) { return static_cast<std::size_t>((static_cast<std::int64_t>(price) - low) / tick); };
+        bids_.ForEachWhile([&](Price price, const PriceLevel& level)
+            {
+                if (price < low)
+                    return false;
+                auctionCurves_.AddBuy(indexOf(price), std::uint64_t{ level.quantity_ } + level.hidden_);
+                return true;
+            });
+        asks_.ForEachWhile([&](Price price, const PriceLevel& level)
+            {
+                if (price > high)
+                    return false;
+                auctionCurves_.AddSell(indexOf(price), std::uint64_t{ level.quantity_ } + level.hidden_);
+                return true;
+            });
+
+        const auto reference = lastTradePrice_ == Constants::InvalidPrice ? AuctionCurves::NoReference
+            : lastTradePrice_ <= low ? 0 : indexOf(std::min(lastTradePrice_, high));
+        const auto clearing = auctionCurves_.Solve(reference);
+        const Price price = static_cast<Price>(low + static_cast<std::int64_t>(clearing.index_) * tick);
+
+        if constexpr (!Allocation::Sequential)
+        {
+            // each side is allocated on its own, then the two fill lists are paired off in order into trades
+            AllocateAuctionSide<Side::Buy>(clearing.volume_, auctionBuys_);
+            AllocateAuctionSide<Side::Sell>(clearing.volume_, auctionSells_);
+
+            std::size_t buy = 0;
+            std::size_t sell = 0;
+            while (buy < auctionBuys_.size())
+            {
+                auto& bid = auctionBuys_[buy];
+                auto& ask = auctionSells_[sell];
+                const auto quantity = std::min(bid.quantity_, ask.quantity_);
+
+                sink(Trade{ TradeInfo{ bid.orderID_, price, quantity }, TradeInfo{ ask.orderID_, price, quantity } });
+                bid.quantity_ -= quantity;
+                ask.quantity_ -= quantity;
+                buy += bid.quantity_ == 0;
+                sell += ask.quantity_ == 0;
+            }
+
+            lastTradePrice_ = price;
+            TriggerStops(sink);
+            return price;
+        }
+
+        // one pass down both queues: the clearing volume never reaches a bid below or an ask above the price
+        auto volume = clearing.volume_;
+        while (volume != 0)
         {
-            return {};
+            const Price bidPrice = bids_.BestPrice();
+            const Price askPrice = asks_.BestPrice();
+            auto& bidLevel = bids_.Best();
+            auto& askLevel = asks_.Best();
+            const auto bid = bidLevel.head_;
+            const auto ask = askLevel.head_;
+
+            const auto quantity = static_cast<Quantity>(std::min<std::uint64_t>(volume,
+                std::min(orderPool_[bid].GetVisibleQuantity(), orderPool_[ask].GetVisibleQuantity())));
+
+            sink(Trade{ TradeInfo{ orderPool_[bid].GetOrderID(), price, quantity }, TradeInfo{ orderPool_[ask].GetOrderID(), price, quantity } });
+            FillResting(bidLevel, bid, quantity);
+            FillResting(askLevel, ask, quantity);
+            volume -= quantity;
+
+            if (bidLevel.empty())
+                bids_.Erase(bidPrice);
+            if (askLevel.empty())
+                asks_.Erase(askPrice);
         }
 
-        const auto& [existingOrder, _] = orders_.at(order.GetOrderID());
-        CancelOrder(order.GetOrderID());
-        return AddOrder(order.ToOrderPointer(existingOrder->GetOrderType()));
+        lastTradePrice_ = price;
+        TriggerStops(sink);
+        return price;
+    }
+
+    Trades Uncross()
+    {
+        Trades trades;
+        Uncross([&trades](const Trade& trade) { trades.push_back(trade); });
+        return trades;
     }
 
     std::size_t Size() const {
-        return orders_.size();
+        return orders_.Size();
+    }
+
+    // occupied price levels plus stop trigger levels, over both sides
+    std::size_t LevelCount() const
+    {
+        return bids_.Count() + asks_.Count() + buyStops_.Count() + sellStops_.Count();
+    }
+
+    Price TickSize() const { return bids_.TickSize(); }
+    Price LastTradePrice() const { return lastTradePrice_; }
+    static constexpr AllocationPolicy AllocationKind() { return Allocation::Kind; }
+
+    // time the book last expired orders up to
+    Timestamp Clock() const { return expiries_.Now(); }
+
+    // walks every order in the book level by level: bids then asks best price first, then the buy and sell stops
+    // in trigger order. levelVisitor(BookQueue, Price, Quantity orderCount) sees each level before
+    // orderVisitor(const Order&) sees its orders in time priority. An orderVisitor(const Order&, bool topOrder)
+    // is also told which order is its level's top order
+    template <typename LevelVisitor, typename OrderVisitor>
+    void ForEachLevel(LevelVisitor&& levelVisitor, OrderVisitor&& orderVisitor) const
+    {
+        auto visit = [&](BookQueue queue, const auto& ladder)
+            {
+                ladder.ForEach([&](Price price, const PriceLevel& level)
+                    {
+                        levelVisitor(queue, price, level.count_);
+                        const auto top = TopOrderOf(level);
+                        for (auto handle = level.head_; handle != InvalidPoolHandle; handle = orderPool_[handle].GetNext())
+                            VisitOrder(orderVisitor, orderPool_[handle], handle == top);
+                    });
+            };
+
+        visit(BookQueue::Bids, bids_);
+        visit(BookQueue::Asks, asks_);
+        visit(BookQueue::BuyStops, buyStops_);
+        visit(BookQueue::SellStops, sellStops_);
     }
 
     OrderbookLevelInfos GetOrderInfos() const
     {
         LevelInfos bidInfos, askInfos;
-        bidInfos.reserve(orders_.size());
-        askInfos.reserve(orders_.size());
+        bidInfos.reserve(bids_.Count());
+        askInfos.reserve(asks_.Count());
 
-        auto CreateLevelInfos = [](Price price, const OrderPointers& orders)
+        auto CreateLevelInfos = [](Price price, const PriceLevel& orders)
             {
-                return LevelInfo{ price , std::accumulate(orders.begin(), orders.end(), (Quantity)0,[](Quantity runningSum, const OrderPointer& order)
-                    {return runningSum + order->GetRemainingQuantity(); }) }; //lamda
+                return LevelInfo{ price, orders.quantity_ };
             };
 
 
-        for (const auto& [price, orders] : bids_)
-            bidInfos.push_back(CreateLevelInfos(price, orders));
+        bids_.ForEach([&](Price price, const PriceLevel& orders)
+            { bidInfos.push_back(CreateLevelInfos(price, orders)); });
 
-        for (const auto& [price, orders] : asks_)
-            askInfos.push_back(CreateLevelInfos(price, orders));
+        asks_.ForEach([&](Price price, const PriceLevel& orders)
+            { askInfos.push_back(CreateLevelInfos(price, orders)); });
 
         return OrderbookLevelInfos{ bidInfos,askInfos };
     }
-};
 
+    // walks only the best levels per side, calling visitor(side, levelInfo) from the top down.
+    // cost depends on levels, not on how deep the book is
+    template <typename Visitor>
+    void GetDepth(std::size_t levels, Visitor&& visitor) const
+    {
+        bids_.ForEachTop(levels, [&](Price price, const PriceLevel& level)
+            { visitor(Side::Buy, LevelInfo{ price, level.quantity_ }); });
 
-int main()
-{
-    Orderbook orderbook;
-    const OrderID orderid = 1;
-    orderbook.AddOrder(std::make_shared<Order>(OrderType::GoodTillCancel, orderid, Side::Buy, 100, 10));
-    std::cout << orderbook.Size() << std::endl;
+        asks_.ForEachTop(levels, [&](Price price, const PriceLevel& level)
+            { visitor(Side::Sell, LevelInfo{ price, level.quantity_ }); });
+    }
 
+    OrderbookDepth GetDepth(std::size_t levels = OrderbookDepth::MaxLevels) const
+    {
+        OrderbookDepth depth;
+        GetDepth(std::min(levels, OrderbookDepth::MaxLevels), [&depth](Side side, const LevelInfo& level)
+            {
+                if (side == Side::Buy)
+                    depth.bids_[depth.bidCount_++] = level;
+                else
+                    depth.asks_[depth.askCount_++] = level;
+            });
 
-    std::cin.get();
-    return 0;
+        return depth;
+    }
+
+    TopOfBook GetTopOfBook() const
+    {
+        TopOfBook top{ };
+        GetDepth(TopOfBook::MaxLevels, [&top](Side side, const LevelInfo& level)
+            {
+                if (side == Side::Buy)
+                    top.bids_[top.bidCount_++] = level;
+                else
+                    top.asks_[top.askCount_++] = level;
+            });
+
+        return top;
+    }
+};
+
+// strict price-time priority, what every existing caller matches with
+using Orderbook = BasicOrderbook<>;
+using ProRataOrderbook = BasicOrderbook<ProRataAllocation>;
+using TopOrderOrderbook = BasicOrderbook<TopOrderAllocation>;
+
+// a book whose allocation policy is chosen at run time, e.g. per symbol. Each alternative is a fully
+// specialized book, so a call costs one dispatch on the variant and nothing inside the matching loop.
+// Reach the book through std::visit
+using AnyOrderbook = std::variant<Orderbook, ProRataOrderbook, TopOrderOrderbook>;
+
+inline std::unique_ptr<AnyOrderbook> MakeOrderbook(AllocationPolicy allocation, Price tickSize = 1)
+{
+    switch (allocation)
+    {
+    case AllocationPolicy::ProRata:
+        return std::make_unique<AnyOrderbook>(std::in_place_type<ProRataOrderbook>, tickSize);
+    case AllocationPolicy::TopOrder:
+        return std::make_unique<AnyOrderbook>(std::in_place_type<TopOrderOrderbook>, tickSize);
+    default:
+        return std::make_unique<AnyOrderbook>(std::in_place_type<Orderbook>, tickSize);
+    }
 }
 
 //com,it
\ No newline at end of file
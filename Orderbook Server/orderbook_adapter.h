@@ -1,51 +1,53 @@
 
 #pragma once
 
-#include <mutex>
-#include <shared_mutex>
+#include <optional>
+#include <chrono>
 
 // Include the headers from the original implementation
 #include "orderbook.cpp"
-
-// This adapter ensures thread safety for the orderbook
-class ThreadSafeOrderbook {
-public:
-    ThreadSafeOrderbook() : orderbook_() {}
-
-    // Add an order with thread safety
-    Trades AddOrder(OrderPointer order) {
-        std::unique_lock<std::shared_mutex> lock(mutex_);
-        return orderbook_.AddOrder(order);
-    }
-
-    // Cancel an order with thread safety
-    void CancelOrder(OrderID orderId) {
-        std::unique_lock<std::shared_mutex> lock(mutex_);
-        orderbook_.CancelOrder(orderId);
+#include "thread_safe_orderbook.h"
+
+// Map the wire order type byte (see OrderType in message_format.h) onto the engine's order type.
+// Types the engine does not support yet come back empty instead of being cast blindly.
+inline std::optional<OrderType> ToOrderType(uint8_t wireOrderType) {
+    switch (wireOrderType) {
+    case 0: return OrderType::GoodTillCancel;
+    case 1: return OrderType::FillandKill;
+    case 2: return OrderType::FillOrKill;
+    case 3: return OrderType::GoodForDay;
+    case 4: return OrderType::Market;
+    case 5: return OrderType::GoodTillDate;
+    case 6: return OrderType::Stop;
+    case 7: return OrderType::StopLimit;
+    default: return std::nullopt;
     }
-
-    // Modify an order with thread safety
-    Trades MatchOrder(OrderModify order) {
-        std::unique_lock<std::shared_mutex> lock(mutex_);
-        return orderbook_.MatchOrder(order);
-    }
-
-    // Get orderbook information with thread safety (read-only operation)
-    OrderbookLevelInfos GetOrderInfos() const {
-        std::shared_lock<std::shared_mutex> lock(mutex_);
-        return orderbook_.GetOrderInfos();
+}
+
+// Seconds since the unix epoch, the clock order expiries are measured against
+inline Timestamp CurrentTimestamp() {
+    return static_cast<Timestamp>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+// GoodForDay orders expire at the session close, 16:00 UTC
+constexpr Timestamp SessionCloseSecondOfDay = 16 * 60 * 60;
+
+inline Timestamp NextSessionClose(Timestamp now) {
+    constexpr Timestamp secondsPerDay = 24 * 60 * 60;
+    const Timestamp close = now - now % secondsPerDay + SessionCloseSecondOfDay;
+    return close > now ? close : close + secondsPerDay;
+}
+
+// GoodForDay orders get the next session close, GoodTillDate orders keep the expiry sent on the wire,
+// everything else never expires
+inline Timestamp ToExpiry(OrderType orderType, uint64_t wireExpiryTime, Timestamp now) {
+    switch (orderType) {
+    case OrderType::GoodForDay: return NextSessionClose(now);
+    case OrderType::GoodTillDate: return wireExpiryTime;
+    default: return 0;
     }
-
-    // Get the size of the orderbook with thread safety (read-only operation)
-    std::size_t Size() const {
-        std::shared_lock<std::shared_mutex> lock(mutex_);
-        return orderbook_.Size();
-    }
-
-private:
-    Orderbook orderbook_;
-    mutable std::shared_mutex mutex_; // Allows multiple readers but exclusive writers
-};
+}
 
 // Adapter class to bridge between the network message format and our orderbook implementation
 class OrderbookNetworkAdapter {
@@ -54,15 +56,24 @@ public:
 
     // Process add order request from network
     std::pair<uint64_t, Trades> ProcessAddOrderRequest(const AddOrderRequest& request) {
+        // Reject order types the engine cannot handle; server order ID 0 marks a rejected request
+        std::optional<OrderType> orderType = ToOrderType(static_cast<uint8_t>(request.orderType));
+        if (!orderType) {
+            return { 0, {} };
+        }
+
         // Create an order from the request
         uint64_t orderId = nextOrderId_++;
 
-        OrderPointer order = std::make_shared<Order>(
-            static_cast<OrderType>(request.orderType),
+        Order order(
+            *orderType,
             orderId,
             static_cast<Side>(request.side),
             request.price,
-            request.quantity
+            request.quantity,
+            ToExpiry(*orderType, request.expiryTime, CurrentTimestamp()),
+            request.displayQuantity,
+            static_cast<Price>(request.stopPrice)
         );
 
         // Add the order to the orderbook
@@ -0,0 +1,248 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include "occupancy_bitmap.h"
+
+// Dense price ladder used for the bids_/asks_ sides of the Orderbook.
+// Levels live in one contiguous array indexed by (price - base) / tick, so inserting
+// or finding a level is O(1) and walking the book scans memory instead of chasing
+// tree nodes. Compare follows the std::map convention the book used before
+// (std::greater for bids, std::less for asks) and decides which end of the array
+// holds the best price. Which slots hold a level is tracked in an OccupancyBitmap, so
+// moving to the next level never scans the empty slots in between.
+template <typename Price, typename Level, typename Compare>
+class PriceLadder
+{
+public:
+    // hard cap on the window so a stray price cannot make us allocate gigabytes
+    static constexpr std::size_t MaxLevels = std::size_t{ 1 } << 20;
+
+    explicit PriceLadder(Price tickSize = 1, std::size_t initialLevels = 1024)
+        : tick_{ tickSize }
+        , levels_(initialLevels)
+        , occupied_(initialLevels)
+    { }
+
+    bool Empty() const { return count_ == 0; }
+    std::size_t Count() const { return count_; }
+    Price TickSize() const { return tick_; }
+
+    bool IsOnTick(Price price) const { return static_cast<std::int64_t>(price) % tick_ == 0; }
+
+    // true if the level can be inserted without the occupied range outgrowing MaxLevels
+    bool CanInsert(Price price) const
+    {
+        if (!IsOnTick(price))
+            return false;
+
+        if (Covers(price) || Empty())
+            return true;
+
+        const auto low = std::min<std::int64_t>(price, PriceAt(std::min(best_, worst_)));
+        const auto high = std::max<std::int64_t>(price, PriceAt(std::max(best_, worst_)));
+        return static_cast<std::size_t>((high - low) / tick_) < MaxLevels;
+    }
+
+    // best level, only valid when not Empty()
+    Price BestPrice() const { return PriceAt(best_); }
+    Level& Best() { return levels_[best_]; }
+    const Level& Best() const { return levels_[best_]; }
+
+    Level* Find(Price price)
+    {
+        if (!Covers(price))
+            return nullptr;
+
+        const auto index = IndexOf(price);
+        return occupied_.Test(index) ? &levels_[index] : nullptr;
+    }
+
+    const Level* Find(Price price) const
+    {
+        return const_cast<PriceLadder*>(this)->Find(price);
+    }
+
+    // returns the level at price, creating (and recentering the window) if needed
+    Level& Insert(Price price)
+    {
+        if (!Covers(price))
+            Recenter(price);
+
+        const auto index = IndexOf(price);
+        if (!occupied_.Test(index))
+        {
+            occupied_.Set(index);
+
+            if (count_++ == 0)
+            {
+                best_ = worst_ = index;
+            }
+            else
+            {
+                if (Better(index, best_))
+                    best_ = index;
+                if (Better(worst_, index))
+                    worst_ = index;
+            }
+        }
+
+        return levels_[index];
+    }
+
+    void Erase(Price price)
+    {
+        const auto index = IndexOf(price);
+        levels_[index] = Level{ };
+        occupied_.Clear(index);
+
+        if (--count_ == 0)
+            return;
+
+        // only the edges of the occupied range need to move
+        if (index == best_)
+            best_ = Next(best_, Step);
+        if (index == worst_)
+            worst_ = Next(worst_, -Step);
+    }
+
+    // visits occupied levels from best to worst
+    template <typename Visitor>
+    void ForEach(Visitor&& visitor) const
+    {
+        if (Empty())
+            return;
+
+        for (auto index = best_; ; index = Next(index, Step))
+        {
+            visitor(PriceAt(index), levels_[index]);
+
+            if (index == worst_)
+                break;
+        }
+    }
+
+    // visits occupied levels from best to worst for as long as visitor returns true
+    template <typename Visitor>
+    void ForEachWhile(Visitor&& visitor) const
+    {
+        if (Empty())
+            return;
+
+        for (auto index = best_; ; index = Next(index, Step))
+        {
+            if (!visitor(PriceAt(index), levels_[index]))
+                break;
+
+            if (index == worst_)
+                break;
+        }
+    }
+
+    // visits at most limit occupied levels from the best one down and returns how many it saw
+    template <typename Visitor>
+    std::size_t ForEachTop(std::size_t limit, Visitor&& visitor) const
+    {
+        std::size_t visited = 0;
+        if (Empty())
+            return visited;
+
+        for (auto index = best_; visited < limit; index = Next(index, Step))
+        {
+            visitor(PriceAt(index), levels_[index]);
+            ++visited;
+
+            if (index == worst_)
+                break;
+        }
+
+        return visited;
+    }
+
+private:
+    // +1 when the best level sits at the low end of the array (asks), -1 for bids
+    static constexpr std::ptrdiff_t Step = Compare{ }(1, 0) ? -1 : 1;
+
+    static bool Better(std::ptrdiff_t lhs, std::ptrdiff_t rhs) { return Compare{ }(lhs, rhs); }
+
+    Price PriceAt(std::ptrdiff_t index) const
+    {
+        return static_cast<Price>(base_ + index * static_cast<std::int64_t>(tick_));
+    }
+
+    std::ptrdiff_t IndexOf(Price price) const
+    {
+        return static_cast<std::ptrdiff_t>((static_cast<std::int64_t>(price) - base_) / tick_);
+    }
+
+    bool Covers(Price price) const
+    {
+        const auto offset = static_cast<std::int64_t>(price) - base_;
+        return offset >= 0 && offset / tick_ < static_cast<std::int64_t>(levels_.size());
+    }
+
+    // next occupied level after from in the direction of step; there must be one
+    std::ptrdiff_t Next(std::ptrdiff_t from, std::ptrdiff_t step) const
+    {
+        const auto index = step > 0
+            ? occupied_.NextSet(static_cast<std::size_t>(from + 1))
+            : occupied_.PrevSet(static_cast<std::size_t>(from - 1));
+        return static_cast<std::ptrdiff_t>(index);
+    }
+
+    // moves the window so it holds every occupied level plus price, growing it if the
+    // occupied range no longer fits. Only runs when prices drift out of the window.
+    void Recenter(Price price)
+    {
+        std::int64_t low = price;
+        std::int64_t high = price;
+        if (!Empty())
+        {
+            low = std::min<std::int64_t>(low, PriceAt(std::min(best_, worst_)));
+            high = std::max<std::int64_t>(high, PriceAt(std::max(best_, worst_)));
+        }
+
+        const auto span = static_cast<std::size_t>((high - low) / tick_) + 1;
+        auto capacity = levels_.size();
+        while (capacity < span * 2)
+            capacity *= 2;
+
+        // centre the occupied range so drift in either direction has headroom
+        const auto newBase = low - static_cast<std::int64_t>((capacity - span) / 2) * tick_;
+
+        std::vector<Level> levels(capacity);
+        OccupancyBitmap occupied(capacity);
+
+        if (!Empty())
+        {
+            const auto shift = static_cast<std::ptrdiff_t>((base_ - newBase) / tick_);
+            for (auto index = best_; ; index = Next(index, Step))
+            {
+                levels[index + shift] = std::move(levels_[index]);
+                occupied.Set(static_cast<std::size_t>(index + shift));
+
+                if (index == worst_)
+                    break;
+            }
+
+            best_ += shift;
+            worst_ += shift;
+        }
+
+        levels_ = std::move(levels);
+        occupied_ = std::move(occupied);
+        base_ = newBase;
+    }
+
+    Price tick_;
+    std::int64_t base_{ 0 };
+    std::vector<Level> levels_;
+    OccupancyBitmap occupied_;
+    std::ptrdiff_t best_{ 0 };
+    std::ptrdiff_t worst_{ 0 };
+    std::size_t count_{ 0 };
+};
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Bounded lock-free rings used to hand commands to the matching thread and results back.
+// Capacity must be a power of two; indices run freely and are masked on access. Producer
+// and consumer state sit on separate cache lines so the two sides never share a line.
+inline constexpr std::size_t CacheLineSize = 64;
+
+// Single producer, single consumer. Each side keeps a cached copy of the other side's index,
+// so the shared atomics are only read when the ring looks full or empty.
+template <typename T, std::size_t Capacity>
+class SpscRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // producer side; false when the ring is full
+    bool TryPush(const T& value)
+    {
+        const auto head = head_.load(std::memory_order_relaxed);
+        if (head - cachedTail_ == Capacity)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head - cachedTail_ == Capacity)
+                return false;
+        }
+
+        slots_[head & Mask] = value;
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // consumer side; false when the ring is empty
+    bool TryPop(T& value)
+    {
+        const auto tail = tail_.load(std::memory_order_relaxed);
+        if (tail == cachedHead_)
+        {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail == cachedHead_)
+                return false;
+        }
+
+        value = slots_[tail & Mask];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static constexpr std::size_t Mask = Capacity - 1;
+
+    alignas(CacheLineSize) std::atomic<std::size_t> head_{ 0 };
+    std::size_t cachedTail_{ 0 };
+    alignas(CacheLineSize) std::atomic<std::size_t> tail_{ 0 };
+    std::size_t cachedHead_{ 0 };
+    alignas(CacheLineSize) std::array<T, Capacity> slots_{ };
+};
+
+// Multiple producers, single consumer. Every cell carries a sequence number that tells
+// producers whether it is free for their ticket and tells the consumer whether it has been
+// published, so producers only contend on one fetch of the head ticket and never block.
+template <typename T, std::size_t Capacity>
+class MpscRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    MpscRing()
+    {
+        for (std::size_t index = 0; index < Capacity; ++index)
+            cells_[index].sequence_.store(index, std::memory_order_relaxed);
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    // any thread; false when the ring is full
+    bool TryPush(const T& value)
+    {
+        auto ticket = head_.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& cell = cells_[ticket & Mask];
+            const auto sequence = cell.sequence_.load(std::memory_order_acquire);
+            const auto lag = static_cast<std::ptrdiff_t>(sequence - ticket);
+
+            if (lag == 0)
+            {
+                if (head_.compare_exchange_weak(ticket, ticket + 1, std::memory_order_relaxed))
+                {
+                    cell.value_ = value;
+                    cell.sequence_.store(ticket + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (lag < 0)
+            {
+                // the consumer has not freed this cell yet
+                return false;
+            }
+            else
+            {
+                ticket = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // consumer thread only; false when nothing has been published
+    bool TryPop(T& value)
+    {
+        auto& cell = cells_[tail_ & Mask];
+        if (cell.sequence_.load(std::memory_order_acquire) != tail_ + 1)
+            return false;
+
+        value = cell.value_;
+        cell.sequence_.store(tail_ + Capacity, std::memory_order_release);
+        ++tail_;
+        return true;
+    }
+
+private:
+    static constexpr std::size_t Mask = Capacity - 1;
+
+    struct Cell
+    {
+        std::atomic<std::size_t> sequence_{ 0 };
+        T value_{ };
+    };
+
+    alignas(CacheLineSize) std::atomic<std::size_t> head_{ 0 };
+    alignas(CacheLineSize) std::size_t tail_{ 0 };
+    alignas(CacheLineSize) std::array<Cell, Capacity> cells_;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Sequence lock for publishing a small snapshot from one writer to any number of readers.
+// The writer never waits: it bumps the sequence to odd, copies the value in and bumps it back
+// to even. Readers copy the value out and retry if the sequence moved underneath them, so
+// they never write shared state and cannot hold the writer up. Readers are lock-free, not
+// wait-free: one that lands on a Store in progress spins until it is done, so a writer storing
+// back to back can keep a reader retrying. The payload is kept in relaxed atomic words, which
+// keeps the torn reads that get retried well defined.
+template <typename T>
+class SeqLock
+{
+    // copied in and out as raw words, so T must not have constructors or member initializers
+    static_assert(std::is_trivial_v<T>, "SeqLock payload must be a trivial type");
+
+public:
+    SeqLock()
+    {
+        Store(T{ });
+    }
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    // single writer only
+    void Store(const T& value)
+    {
+        std::array<std::uint64_t, Words> words{ };
+        std::memcpy(words.data(), &value, sizeof(T));
+
+        const auto sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (std::size_t index = 0; index < Words; ++index)
+            words_[index].store(words[index], std::memory_order_relaxed);
+
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    // any thread, lock-free; retries while a Store is in progress
+    T Load() const
+    {
+        std::array<std::uint64_t, Words> words;
+        for (;;)
+        {
+            const auto before = sequence_.load(std::memory_order_acquire);
+            if (before & 1)
+                continue;
+
+            for (std::size_t index = 0; index < Words; ++index)
+                words[index] = words_[index].load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before)
+                break;
+        }
+
+        T value;
+        std::memcpy(&value, words.data(), sizeof(T));
+        return value;
+    }
+
+    // number of Stores so far, lets pollers skip snapshots they have already seen
+    std::uint64_t Version() const { return sequence_.load(std::memory_order_acquire) / 2; }
+
+private:
+    static constexpr std::size_t Words = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    // sequence and payload start on their own cache line so nothing else shares it with readers
+    alignas(64) std::atomic<std::uint64_t> sequence_{ 0 };
+    std::array<std::atomic<std::uint64_t>, Words> words_{ };
+};
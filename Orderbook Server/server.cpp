@@ -7,6 +7,11 @@
 #include <unordered_map>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
 
@@ -18,17 +23,114 @@
 // Our headers
 #include "message_format.h"
 #include "task_queue.h"
-#include "orderbook.h"
+#include "book_manager.h"
+#include "journal.h"
+#include "book_snapshot.h"
 
 // Maximum receive buffer size
 constexpr size_t MAX_BUFFER_SIZE = 4096;
 
+// Number of instruments the server keeps books for; symbol IDs on the wire are 0..MAX_SYMBOLS-1
+constexpr size_t MAX_SYMBOLS = 1024;
+
+// Write-ahead journal of every accepted add/cancel/modify, appended from the matching threads
+constexpr const char* JOURNAL_PATH = "orderbook.journal";
+
+// Optional per-symbol book settings, one "<symbol> <fifo|prorata|toporder> [tick size]" per line; symbols
+// not listed match FIFO with a tick size of 1
+constexpr const char* BOOK_CONFIG_PATH = "books.cfg";
+
+// Books are saved here as <symbol>.snapshot; a restart loads them and replays only the journal after them
+constexpr const char* SNAPSHOT_DIRECTORY = "snapshots";
+constexpr std::chrono::seconds SNAPSHOT_INTERVAL(60);
+
+// What the snapshot thread measured, published for anyone to read while the server runs.
+// The matching pauses are the capture pass plus the longest copy-on-write stop of one book
+struct SnapshotMetrics {
+    std::atomic<uint64_t> runs_{ 0 };              // snapshot runs that saved at least one book
+    std::atomic<uint64_t> books_{ 0 };             // books saved by the last run
+    std::atomic<uint64_t> orders_{ 0 };            // orders saved by the last run
+    std::atomic<int64_t> durationUs_{ 0 };         // wall time of the last run
+    std::atomic<int64_t> longestPauseUs_{ 0 };     // worst single matching pause of the last run
+    std::atomic<int64_t> worstPauseUs_{ 0 };       // worst single matching pause since the server started
+};
+
+// One connected client. Only the client's session thread ever writes to its socket: replies from the
+// session itself and results from the matching threads are queued here as wire bytes, and the session
+// loop sends them. Once the session is closed anything still queued or posted later is dropped, so no
+// thread can write to a socket handle that has since been reused for another connection.
+class ClientSession {
+public:
+    explicit ClientSession(SOCKET socket)
+        : socket_(socket) {
+    }
+
+    // Any thread: queues a message for the client; a no-op once the session is closed
+    void post(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!closed_) {
+            outbox_.insert(outbox_.end(), bytes, bytes + size);
+        }
+    }
+
+    // Session thread: sends as much of the queue as the socket takes right now. A partial write keeps
+    // its place and the rest goes out on the next call; false only on a real send error. The socket is
+    // non-blocking, so holding the lock only ever keeps posters waiting for one pass of sends
+    bool flush() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closed_) {
+            return true;
+        }
+
+        if (pending_.empty()) {
+            pending_.swap(outbox_);
+        }
+        else {
+            pending_.insert(pending_.end(), outbox_.begin(), outbox_.end());
+            outbox_.clear();
+        }
+
+        while (sent_ < pending_.size()) {
+            int bytesSent = send(socket_, (const char*)pending_.data() + sent_, static_cast<int>(pending_.size() - sent_), 0);
+            if (bytesSent == SOCKET_ERROR) {
+                return WSAGetLastError() == WSAEWOULDBLOCK;
+            }
+            sent_ += bytesSent;
+        }
+
+        pending_.clear();
+        sent_ = 0;
+        return true;
+    }
+
+    // Any thread: from here on nothing is queued or sent. Waits out a flush in progress, so once it
+    // returns the socket can be closed
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        outbox_.clear();
+    }
+
+private:
+    const SOCKET socket_;
+    std::mutex mutex_;
+    std::vector<uint8_t> outbox_;  // filled by any thread
+    bool closed_ = false;
+    std::vector<uint8_t> pending_; // taken from the outbox by flush, sent_ bytes of it already written
+    size_t sent_ = 0;              // all of the above guarded by mutex_
+};
+
 class TcpServer {
 public:
-    TcpServer(int port, int numThreads)
+    TcpServer(int port, int numThreads, int numMatchingThreads)
         : port_(port),
+        journal_(JOURNAL_PATH),
+        appliedSequence_(MAX_SYMBOLS, 0),
+        snapshotSequence_(MAX_SYMBOLS, 0),
+        captures_(MAX_SYMBOLS),
+        books_(numMatchingThreads, MAX_SYMBOLS),
         threadPool_(numThreads),
-        orderbook_(),
         nextClientId_(1),
         running_(false) {
     }
@@ -39,6 +141,12 @@ public:
 
     // Start the server
     bool start() {
+        // Books have to know their allocation policy and tick size before anything creates them
+        configureBooks();
+
+        // Rebuild the books before any client can reach them
+        recover();
+
         // Initialize Winsock
         WSADATA wsaData;
         if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
@@ -115,6 +223,8 @@ public:
 
         running_ = true;
         acceptThread_ = std::thread(&TcpServer::acceptConnections, this);
+        expiryThread_ = std::thread(&TcpServer::expireOrders, this);
+        snapshotThread_ = std::thread(&TcpServer::snapshotBooks, this);
 
         return true;
     }
@@ -134,20 +244,198 @@ public:
             acceptThread_.join();
         }
 
-        // Close all client connections
+        // Wait for expiry thread to finish
+        if (expiryThread_.joinable()) {
+            expiryThread_.join();
+        }
+
+        // Wait for snapshot thread to finish
+        if (snapshotThread_.joinable()) {
+            snapshotThread_.join();
+        }
+
+        // Stop sending to every client; each session thread sees running_ is false and closes its own
+        // socket, so no socket is closed while its thread may still use the handle
         {
             std::lock_guard<std::mutex> lock(clientsMutex_);
             for (auto& client : clients_) {
-                closesocket(client.first);
+                client.second->close();
             }
-            clients_.clear();
+        }
+
+        while (true) {
+            {
+                std::lock_guard<std::mutex> lock(clientsMutex_);
+                if (clients_.empty()) {
+                    break;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
 
         // Cleanup Winsock
         WSACleanup();
     }
 
+    // Snapshot duration and matching pauses, updated after every snapshot run
+    const SnapshotMetrics& snapshotMetrics() const {
+        return snapshotMetrics_;
+    }
+
 private:
+    // Thread function that moves the book's expiry clock forward. Only orders that are due get
+    // touched, so the session close is one batched pass instead of a scan over every resting order
+    void expireOrders() {
+        while (running_) {
+            books_.ExpireOrders(CurrentTimestamp());
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+
+    // Reads BOOK_CONFIG_PATH if there is one; a line that does not parse is reported and skipped
+    void configureBooks() {
+        std::ifstream in(BOOK_CONFIG_PATH);
+        std::string line;
+        for (size_t lineNumber = 1; std::getline(in, line); ++lineNumber) {
+            if (line.empty() || line[0] == '#') {
+                continue;
+            }
+
+            std::istringstream fields(line);
+            long symbol = -1;
+            std::string allocation;
+            Price tickSize = 1;
+            fields >> symbol >> allocation;
+            if (!(fields >> tickSize)) {
+                tickSize = fields.eof() ? 1 : 0;
+            }
+
+            const std::optional<AllocationPolicy> policy = ToAllocationPolicy(allocation);
+            if (symbol < 0 || symbol >= static_cast<long>(MAX_SYMBOLS) || !policy
+                || !books_.Configure(static_cast<SymbolId>(symbol), BookConfig{ *policy, tickSize })) {
+                std::cerr << BOOK_CONFIG_PATH << ":" << lineNumber << ": ignoring \"" << line << "\"" << std::endl;
+            }
+        }
+    }
+
+    static std::string snapshotPath(SymbolId symbol) {
+        return std::string(SNAPSHOT_DIRECTORY) + "/" + std::to_string(symbol) + ".snapshot";
+    }
+
+    // Loads every book's latest snapshot, bulk-inserting its orders without matching, then replays
+    // the journal records the snapshots do not already reflect. A restored book keeps the tick size
+    // and allocation policy it was saved with, whatever books.cfg says now, so its queues match the
+    // same way they did. A book whose snapshot cannot be read is rebuilt from the whole journal instead
+    void recover() {
+        const auto started = std::chrono::steady_clock::now();
+        std::filesystem::create_directories(SNAPSHOT_DIRECTORY);
+
+        for (size_t symbol = 0; symbol < MAX_SYMBOLS; ++symbol) {
+            const std::string path = snapshotPath(static_cast<SymbolId>(symbol));
+            if (!std::filesystem::exists(path)) {
+                continue;
+            }
+
+            books_.Rebuild(static_cast<SymbolId>(symbol), [this, symbol, path](std::unique_ptr<AnyOrderbook>& book) {
+                const SnapshotHeader header = LoadBookSnapshot(path, book);
+                appliedSequence_[symbol] = snapshotSequence_[symbol] = header.sequence_;
+                },
+                [](const std::exception& error) {
+                    std::cerr << "Ignoring " << error.what() << std::endl;
+                });
+        }
+
+        // each record goes to its book's matching thread behind the snapshot load
+        const size_t records = journal_.ForEach([this](const JournalRecord& record) {
+            books_.Post(record.symbol_, [this, record](auto& book) {
+                if (record.sequence_ > appliedSequence_[record.symbol_]) {
+                    record.ApplyTo(book);
+                    appliedSequence_[record.symbol_] = record.sequence_;
+                }
+                });
+            });
+        books_.Wait();
+
+        uint64_t lastSequence = 0;
+        for (uint64_t sequence : appliedSequence_) {
+            lastSequence = MAX(lastSequence, sequence);
+        }
+        journal_.SkipPast(lastSequence);
+
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        std::cout << "Recovered books from snapshots and " << records << " journal records in " << elapsed.count() << " ms" << std::endl;
+    }
+
+    // Thread function that saves every book that changed since its last snapshot without holding up
+    // matching. Each matching thread only freezes its books copy-on-write between two commands, in
+    // one pass over their levels; the orders are written out here while matching carries on
+    void snapshotBooks() {
+        auto due = std::chrono::steady_clock::now() + SNAPSHOT_INTERVAL;
+        while (running_) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (std::chrono::steady_clock::now() < due) {
+                continue;
+            }
+            due += SNAPSHOT_INTERVAL;
+
+            const auto started = std::chrono::steady_clock::now();
+            books_.ForEachBook([this](SymbolId symbol, AnyOrderbook& book) {
+                PendingSnapshot& pending = captures_[symbol];
+                pending.book_ = nullptr;
+                if (appliedSequence_[symbol] == snapshotSequence_[symbol]) {
+                    return;
+                }
+
+                const auto captureStarted = std::chrono::steady_clock::now();
+                if (std::visit([&pending](auto& typed) { return typed.BeginCapture(pending.capture_); }, book)) {
+                    pending.book_ = &book;
+                    pending.sequence_ = appliedSequence_[symbol];
+                    pending.pause_ = std::chrono::steady_clock::now() - captureStarted;
+                }
+                });
+            books_.Wait();
+
+            size_t saved = 0;
+            size_t orders = 0;
+            std::chrono::nanoseconds longestPause{ 0 };
+            for (size_t symbol = 0; symbol < MAX_SYMBOLS; ++symbol) {
+                PendingSnapshot& pending = captures_[symbol];
+                if (pending.book_ == nullptr) {
+                    continue;
+                }
+
+                try {
+                    std::visit([&](auto& book) {
+                        WriteCapturedSnapshot(snapshotPath(static_cast<SymbolId>(symbol)), book, pending.capture_,
+                            static_cast<SymbolId>(symbol), pending.sequence_);
+                        }, *pending.book_);
+                    snapshotSequence_[symbol] = pending.sequence_;
+                    ++saved;
+                    orders += pending.capture_.orderCount_;
+                }
+                catch (const std::exception& error) {
+                    std::cerr << "Snapshot of symbol " << symbol << " failed: " << error.what() << std::endl;
+                }
+
+                // the capture pass plus the longest copy-on-write stop is the worst single pause matching saw
+                longestPause = MAX(longestPause, pending.pause_ + std::visit([](const auto& book) { return book.LongestCaptureStall(); }, *pending.book_));
+                pending.book_ = nullptr;
+            }
+
+            if (saved != 0) {
+                const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+                const auto pause = std::chrono::duration_cast<std::chrono::microseconds>(longestPause);
+                snapshotMetrics_.books_.store(saved, std::memory_order_relaxed);
+                snapshotMetrics_.orders_.store(orders, std::memory_order_relaxed);
+                snapshotMetrics_.durationUs_.store(elapsed.count(), std::memory_order_relaxed);
+                snapshotMetrics_.longestPauseUs_.store(pause.count(), std::memory_order_relaxed);
+                snapshotMetrics_.worstPauseUs_.store(MAX(snapshotMetrics_.worstPauseUs_.load(std::memory_order_relaxed), static_cast<int64_t>(pause.count())),
+                    std::memory_order_relaxed);
+                snapshotMetrics_.runs_.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
     // Thread function to accept connections
     void acceptConnections() {
         while (running_) {
@@ -175,22 +463,24 @@ private:
             ioctlsocket(clientSocket, FIONBIO, &mode);
 
             // Add to clients map
+            std::shared_ptr<ClientSession> session = std::make_shared<ClientSession>(clientSocket);
             uint32_t clientId;
             {
                 std::lock_guard<std::mutex> lock(clientsMutex_);
                 clientId = nextClientId_++;
-                clients_[clientSocket] = clientId;
+                clients_[clientSocket] = session;
             }
 
             // Create a task to handle client communication
-            threadPool_.enqueue([this, clientSocket, clientId, clientIP, clientPort]() {
-                handleClient(clientSocket, clientId, clientIP, clientPort);
+            threadPool_.enqueue([this, session, clientSocket, clientId, clientIP, clientPort]() {
+                handleClient(session, clientSocket, clientId, clientIP, clientPort);
                 });
         }
     }
 
-    // Handle client communication
-    void handleClient(SOCKET clientSocket, uint32_t clientId, const std::string& clientIP, int clientPort) {
+    // Handle client communication; this is the only thread that writes to the client's socket
+    void handleClient(const std::shared_ptr<ClientSession>& session, SOCKET clientSocket, uint32_t clientId,
+        const std::string& clientIP, int clientPort) {
         std::vector<uint8_t> buffer(MAX_BUFFER_SIZE);
         std::vector<uint8_t> messageBuffer; // Buffer for accumulating partial messages
 
@@ -203,7 +493,7 @@ private:
                 messageBuffer.insert(messageBuffer.end(), buffer.begin(), buffer.begin() + bytesRead);
 
                 // Process complete messages
-                processMessageBuffer(clientSocket, clientId, messageBuffer);
+                processMessageBuffer(session, clientId, messageBuffer);
             }
             else if (bytesRead == 0) {
                 // Client disconnected
@@ -219,10 +509,19 @@ private:
                 }
             }
 
+            // Send whatever this thread and the matching threads queued for the client
+            if (!session->flush()) {
+                std::cerr << "Error sending data: " << WSAGetLastError() << std::endl;
+                break;
+            }
+
             // Sleep to prevent CPU hogging in non-blocking mode
             std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
 
+        // Results still on their way from the matching threads are dropped from here on
+        session->close();
+
         // Remove client from map
         {
             std::lock_guard<std::mutex> lock(clientsMutex_);
@@ -234,7 +533,7 @@ private:
     }
 
     // Process buffer that may contain multiple or partial messages
-    void processMessageBuffer(SOCKET clientSocket, uint32_t clientId, std::vector<uint8_t>& buffer) {
+    void processMessageBuffer(const std::shared_ptr<ClientSession>& session, uint32_t clientId, std::vector<uint8_t>& buffer) {
         // Keep processing until buffer doesn't have a complete message
         while (buffer.size() >= sizeof(MessageHeader)) {
             // Peek at the header
@@ -249,7 +548,7 @@ private:
             }
 
             // Process the complete message
-            processMessage(clientSocket, clientId, buffer.data(), header.length);
+            processMessage(session, clientId, buffer.data(), header.length);
 
             // Remove the processed message from the buffer
             buffer.erase(buffer.begin(), buffer.begin() + header.length);
@@ -257,46 +556,46 @@ private:
     }
 
     // Process a single complete message
-    void processMessage(SOCKET clientSocket, uint32_t clientId, uint8_t* data, uint32_t length) {
+    void processMessage(const std::shared_ptr<ClientSession>& session, uint32_t clientId, uint8_t* data, uint32_t length) {
         MessageHeader* header = reinterpret_cast<MessageHeader*>(data);
 
         switch (header->type) {
         case MessageType::REQ_ECHO:
-            handleEchoRequest(clientSocket, data, length);
+            handleEchoRequest(session, data, length);
             break;
 
         case MessageType::REQ_QUIT:
-            handleQuitRequest(clientSocket, clientId);
+            handleQuitRequest(*session, clientId);
             break;
 
         case MessageType::REQ_LISTUSERS:
-            handleListUsersRequest(clientSocket);
+            handleListUsersRequest(*session);
             break;
 
         case MessageType::REQ_ADD_ORDER:
-            handleAddOrderRequest(clientSocket, data, length);
+            handleAddOrderRequest(session, data, length);
             break;
 
         case MessageType::REQ_CANCEL_ORDER:
-            handleCancelOrderRequest(clientSocket, data, length);
+            handleCancelOrderRequest(session, data, length);
             break;
 
         case MessageType::REQ_MODIFY_ORDER:
-            handleModifyOrderRequest(clientSocket, data, length);
+            handleModifyOrderRequest(session, data, length);
             break;
 
         case MessageType::REQ_ORDERBOOK_STATUS:
-            handleOrderbookStatusRequest(clientSocket);
+            handleOrderbookStatusRequest(session, data, length);
             break;
 
         default:
-            handleUnknownRequest(clientSocket, header->sequence);
+            handleUnknownRequest(*session, header->sequence);
             break;
         }
     }
 
     // Handle echo request
-    void handleEchoRequest(SOCKET clientSocket, uint8_t* data, uint32_t length) {
+    void handleEchoRequest(const std::shared_ptr<ClientSession>& session, uint8_t* data, uint32_t length) {
         EchoRequest* request = reinterpret_cast<EchoRequest*>(data);
 
         // Create response
@@ -309,12 +608,12 @@ private:
         // Convert to network byte order
         response.header.toNetworkOrder();
 
-        // Send response
-        send(clientSocket, (const char*)&response, sizeof(response), 0);
+        // Queue response
+        session->post(&response, sizeof(response));
     }
 
     // Handle quit request
-    void handleQuitRequest(SOCKET clientSocket, uint32_t clientId) {
+    void handleQuitRequest(ClientSession& session, uint32_t clientId) {
         // Client is handled in the handleClient method
         // Just send an acknowledgment here
         MessageHeader response;
@@ -323,11 +622,11 @@ private:
         response.sequence = 0;
         response.toNetworkOrder();
 
-        send(clientSocket, (const char*)&response, sizeof(response), 0);
+        session.post(&response, sizeof(response));
     }
 
     // Handle list users request
-    void handleListUsersRequest(SOCKET clientSocket) {
+    void handleListUsersRequest(ClientSession& session) {
         // Simple response with the number of connected clients
         char responseBuffer[512];
         ZeroMemory(responseBuffer, sizeof(responseBuffer));
@@ -347,173 +646,250 @@ private:
         char* message = responseBuffer + sizeof(MessageHeader) + sizeof(uint32_t);
         sprintf_s(message, 256, "Connected clients: %u", ntohl(*numClients));
 
+        const uint32_t responseLength = header->length;
         header->toNetworkOrder();
-        send(clientSocket, responseBuffer, header->length, 0);
+        session.post(responseBuffer, responseLength);
     }
 
     // Handle add order request
-    void handleAddOrderRequest(SOCKET clientSocket, uint8_t* data, uint32_t length) {
-        AddOrderRequest* request = reinterpret_cast<AddOrderRequest*>(data);
-        request->toHostOrder();
+    void handleAddOrderRequest(const std::shared_ptr<ClientSession>& session, uint8_t* data, uint32_t length) {
+        AddOrderRequest request = *reinterpret_cast<AddOrderRequest*>(data);
+        request.toHostOrder();
+
+        std::optional<OrderType> orderType = ToOrderType(static_cast<uint8_t>(request.orderType));
+        if (!orderType) {
+            sendAddOrderResponse(*session, request, 1); // Unsupported order type, no book is touched
+            return;
+        }
 
         // Create order for the orderbook
-        OrderPointer order = std::make_shared<Order>(
-            static_cast<OrderType>(request->orderType),
-            request->clientOrderId,
-            static_cast<Side>(request->side),
-            request->price,
-            request->quantity
+        Order order(
+            *orderType,
+            request.clientOrderId,
+            static_cast<Side>(request.side),
+            request.price,
+            request.quantity,
+            ToExpiry(*orderType, request.expiryTime, CurrentTimestamp()),
+            request.displayQuantity,
+            static_cast<Price>(request.stopPrice)
         );
 
-        // Add to orderbook
-        Trades trades = orderbook_.AddOrder(order);
+        // Match on the symbol's own thread, serializing notifications straight from the matching loop
+        // into the session's queue; the session thread sends them
+        bool posted = books_.Post(request.symbolId, [this, session, request, order](auto& book) {
+            appliedSequence_[request.symbolId] = journal_.Append(JournalRecord::Add(request.symbolId, book.Clock(), order));
+
+            std::vector<TradeNotification>& notifications = notificationBatch();
+            book.AddOrder(order, [&notifications, &request](const Trade& trade) {
+                notifications.push_back(makeTradeNotification(request.symbolId, trade));
+                });
+
+            sendAddOrderResponse(*session, request, 0);
+            sendTradeNotifications(*session, notifications);
+            });
+
+        if (!posted) {
+            sendAddOrderResponse(*session, request, 2); // Unknown symbol
+        }
+    }
 
+    void sendAddOrderResponse(ClientSession& session, const AddOrderRequest& request, uint8_t status) {
         // Create response
         AddOrderResponse response;
         response.header.type = MessageType::RSP_ADD_ORDER;
         response.header.length = sizeof(AddOrderResponse);
-        response.header.sequence = request->header.sequence;
-        response.clientOrderId = request->clientOrderId;
-        response.serverOrderId = request->clientOrderId; // Using client ID as server ID for simplicity
-        response.status = 0; // Success
+        response.header.sequence = request.header.sequence;
+        response.clientOrderId = request.clientOrderId;
+        response.serverOrderId = request.clientOrderId; // Using client ID as server ID for simplicity
+        response.status = status;
 
         // Convert to network byte order
         response.toNetworkOrder();
 
-        // Send response
-        send(clientSocket, (const char*)&response, sizeof(response), 0);
-
-        // Send trade notifications if any
-        for (const auto& trade : trades) {
-            sendTradeNotification(clientSocket, trade);
-        }
+        // Queue response
+        session.post(&response, sizeof(response));
     }
 
     // Handle cancel order request
-    void handleCancelOrderRequest(SOCKET clientSocket, uint8_t* data, uint32_t length) {
-        CancelOrderRequest* request = reinterpret_cast<CancelOrderRequest*>(data);
-        request->toHostOrder();
-
-        // Cancel in orderbook
-        orderbook_.CancelOrder(request->orderId);
+    void handleCancelOrderRequest(const std::shared_ptr<ClientSession>& session, uint8_t* data, uint32_t length) {
+        CancelOrderRequest request = *reinterpret_cast<CancelOrderRequest*>(data);
+        request.toHostOrder();
+
+        // Cancel in the symbol's orderbook
+        bool posted = books_.Post(request.symbolId, [this, session, request](auto& book) {
+            appliedSequence_[request.symbolId] = journal_.Append(JournalRecord::Cancel(request.symbolId, book.Clock(), request.orderId));
+            book.CancelOrder(request.orderId);
+            sendCancelOrderResponse(*session, request, 0);
+            });
+
+        if (!posted) {
+            sendCancelOrderResponse(*session, request, 2); // Unknown symbol
+        }
+    }
 
+    void sendCancelOrderResponse(ClientSession& session, const CancelOrderRequest& request, uint8_t status) {
         // Create response
         CancelOrderResponse response;
         response.header.type = MessageType::RSP_CANCEL_ORDER;
         response.header.length = sizeof(CancelOrderResponse);
-        response.header.sequence = request->header.sequence;
-        response.orderId = request->orderId;
-        response.status = 0; // Success
+        response.header.sequence = request.header.sequence;
+        response.orderId = request.orderId;
+        response.status = status;
 
         // Convert to network byte order
         response.toNetworkOrder();
 
-        // Send response
-        send(clientSocket, (const char*)&response, sizeof(response), 0);
+        // Queue response
+        session.post(&response, sizeof(response));
     }
 
     // Handle modify order request
-    void handleModifyOrderRequest(SOCKET clientSocket, uint8_t* data, uint32_t length) {
-        ModifyOrderRequest* request = reinterpret_cast<ModifyOrderRequest*>(data);
-        request->toHostOrder();
+    void handleModifyOrderRequest(const std::shared_ptr<ClientSession>& session, uint8_t* data, uint32_t length) {
+        ModifyOrderRequest request = *reinterpret_cast<ModifyOrderRequest*>(data);
+        request.toHostOrder();
 
         // Create order modify object
         OrderModify orderModify(
-            request->orderId,
-            static_cast<Side>(request->side),
-            request->price,
-            request->quantity
+            request.orderId,
+            static_cast<Side>(request.side),
+            request.price,
+            request.quantity
         );
 
-        // Modify in orderbook
-        Trades trades = orderbook_.MatchOrder(orderModify);
+        // Modify in the symbol's orderbook, serializing notifications straight from the matching loop
+        bool posted = books_.Post(request.symbolId, [this, session, request, orderModify](auto& book) {
+            appliedSequence_[request.symbolId] = journal_.Append(JournalRecord::Modify(request.symbolId, book.Clock(), orderModify));
 
-        // Create response
-        ModifyOrderRequest response = *request;
-        response.header.type = MessageType::RSP_MODIFY_ORDER;
+            std::vector<TradeNotification>& notifications = notificationBatch();
+            book.MatchOrder(orderModify, [&notifications, &request](const Trade& trade) {
+                notifications.push_back(makeTradeNotification(request.symbolId, trade));
+                });
 
-        // Convert to network byte order
-        response.toNetworkOrder();
+            // Create response
+            ModifyOrderRequest response = request;
+            response.header.type = MessageType::RSP_MODIFY_ORDER;
 
-        // Send response
-        send(clientSocket, (const char*)&response, sizeof(response), 0);
+            // Convert to network byte order
+            response.toNetworkOrder();
 
-        // Send trade notifications if any
-        for (const auto& trade : trades) {
-            sendTradeNotification(clientSocket, trade);
+            // Queue response
+            session->post(&response, sizeof(response));
+
+            // Queue trade notifications if any
+            sendTradeNotifications(*session, notifications);
+            });
+
+        if (!posted) {
+            handleUnknownRequest(*session, request.header.sequence); // Unknown symbol
         }
     }
 
     // Handle orderbook status request
-    void handleOrderbookStatusRequest(SOCKET clientSocket) {
-        OrderbookLevelInfos levelInfos = orderbook_.GetOrderInfos();
+    void handleOrderbookStatusRequest(const std::shared_ptr<ClientSession>& session, uint8_t* data, uint32_t length) {
+        OrderbookStatusRequest request = *reinterpret_cast<OrderbookStatusRequest*>(data);
+        request.toHostOrder();
+
+        // Read the published snapshot; neither the book nor its matching thread is involved
+        TopOfBook top;
+        if (!books_.GetTopOfBook(request.symbolId, top)) {
+            handleUnknownRequest(*session, request.header.sequence); // Unknown symbol
+            return;
+        }
 
         // Create response
         OrderbookStatusResponse response;
         response.header.type = MessageType::RSP_ORDERBOOK_STATUS;
         response.header.length = sizeof(OrderbookStatusResponse);
-        response.header.sequence = 0;
+        response.header.sequence = request.header.sequence;
+        response.symbolId = request.symbolId;
+        response.bidLevelsCount = MIN(top.bidCount_, static_cast<uint32_t>(MAX_LEVELS));
+        response.askLevelsCount = MIN(top.askCount_, static_cast<uint32_t>(MAX_LEVELS));
 
-        // Copy bid levels
-        const auto& bids = levelInfos.GetBids();
-        response.bidLevelsCount = MIN(static_cast<uint32_t>(bids.size()), static_cast<uint32_t>(MAX_LEVELS));
+        // Copy only the top MAX_LEVELS per side into the response
         for (uint32_t i = 0; i < response.bidLevelsCount; ++i) {
-            response.bidLevels[i].price = bids[i].price_;
-            response.bidLevels[i].quantity = bids[i].quantity_;
+            response.bidLevels[i].price = top.bids_[i].price_;
+            response.bidLevels[i].quantity = top.bids_[i].quantity_;
         }
 
-        // Copy ask levels
-        const auto& asks = levelInfos.GetAsks();
-        response.askLevelsCount = MIN(static_cast<uint32_t>(asks.size()), static_cast<uint32_t>(MAX_LEVELS));
         for (uint32_t i = 0; i < response.askLevelsCount; ++i) {
-            response.askLevels[i].price = asks[i].price_;
-            response.askLevels[i].quantity = asks[i].quantity_;
+            response.askLevels[i].price = top.asks_[i].price_;
+            response.askLevels[i].quantity = top.asks_[i].quantity_;
         }
 
         // Convert to network byte order
         response.toNetworkOrder();
 
-        // Send response
-        send(clientSocket, (const char*)&response, sizeof(response), 0);
+        // Queue response
+        session->post(&response, sizeof(response));
     }
 
     // Handle unknown request
-    void handleUnknownRequest(SOCKET clientSocket, uint32_t sequence) {
+    void handleUnknownRequest(ClientSession& session, uint32_t sequence) {
         MessageHeader response;
         response.type = MessageType::CMD_ERROR;
         response.length = sizeof(MessageHeader);
         response.sequence = sequence;
         response.toNetworkOrder();
 
-        send(clientSocket, (const char*)&response, sizeof(response), 0);
+        session.post(&response, sizeof(response));
     }
 
-    void sendTradeNotification(SOCKET clientSocket, const Trade& trade) {
+    // Per worker thread buffer of wire-ready notifications; keeps its capacity between requests
+    static std::vector<TradeNotification>& notificationBatch() {
+        thread_local std::vector<TradeNotification> batch;
+        batch.clear();
+        return batch;
+    }
+
+    static TradeNotification makeTradeNotification(SymbolId symbolId, const Trade& trade) {
         TradeNotification notification;
         notification.header.type = MessageType::NOTIFY_TRADE;
         notification.header.length = sizeof(TradeNotification);
         notification.header.sequence = 0;
-        notification.buyOrderId = trade.GetBidTrade().orderId_;
-        notification.sellOrderId = trade.GetAskTrade().orderId_;
+        notification.symbolId = symbolId;
+        notification.buyOrderId = trade.GetBidTrade().orderID_;
+        notification.sellOrderId = trade.GetAskTrade().orderID_;
         notification.price = trade.GetBidTrade().price_;
         notification.quantity = trade.GetBidTrade().quantity_;
 
         // Convert to network byte order
         notification.toNetworkOrder();
+        return notification;
+    }
+
+    // Notifications are packed back to back, so the whole batch is queued in one go
+    void sendTradeNotifications(ClientSession& session, const std::vector<TradeNotification>& notifications) {
+        if (notifications.empty()) {
+            return;
+        }
 
-        // Send notification
-        send(clientSocket, (const char*)&notification, sizeof(notification), 0);
+        session.post(notifications.data(), notifications.size() * sizeof(TradeNotification));
     }
 
     int port_;
     SOCKET serverSocket_ = INVALID_SOCKET;
+    JournalWriter journal_; // declared before books_ so it flushes only after the matching threads have stopped
+    std::vector<uint64_t> appliedSequence_;  // per symbol: last journal record applied to its book, only touched by its shard
+    std::vector<uint64_t> snapshotSequence_; // per symbol: last journal record its saved snapshot covers, written by the snapshot thread, read by its shard behind the queue
+
+    // a book frozen by its matching thread, waiting for the snapshot thread to write it out
+    struct PendingSnapshot {
+        AnyOrderbook* book_ = nullptr;
+        BookCapture capture_;
+        uint64_t sequence_ = 0;
+        std::chrono::nanoseconds pause_{ 0 };
+    };
+    std::vector<PendingSnapshot> captures_;  // per symbol
+    SnapshotMetrics snapshotMetrics_;        // written by the snapshot thread only
+    BookManager books_; // one book per symbol, sharded over dedicated matching threads; outlives the workers posting to it
     TaskQueue threadPool_;
-    ThreadSafeOrderbook orderbook_;
     std::atomic<uint32_t> nextClientId_;
     std::atomic<bool> running_;
     std::thread acceptThread_;
+    std::thread expiryThread_;
+    std::thread snapshotThread_;
     std::mutex clientsMutex_;
-    std::unordered_map<SOCKET, uint32_t> clients_; // socket -> client id
+    std::unordered_map<SOCKET, std::shared_ptr<ClientSession>> clients_; // socket -> session, until its thread closes the socket
 };
 
 int main() {
@@ -525,16 +901,30 @@ int main() {
     std::cout << "Enter number of worker threads: ";
     std::cin >> numThreads;
 
-    TcpServer server(port, numThreads);
+    int numMatchingThreads;
+    std::cout << "Enter number of matching threads: ";
+    std::cin >> numMatchingThreads;
+
+    TcpServer server(port, numThreads, numMatchingThreads);
 
     if (!server.start()) {
         std::cerr << "Failed to start server" << std::endl;
         return 1;
     }
 
-    std::cout << "Server started. Press Enter to stop." << std::endl;
+    std::cout << "Server started. Type \"stats\" for snapshot metrics, press Enter to stop." << std::endl;
     std::cin.ignore(); // Clear the newline from previous input
-    std::cin.get();    // Wait for Enter
+
+    std::string command;
+    while (std::getline(std::cin, command) && command == "stats") {
+        const SnapshotMetrics& metrics = server.snapshotMetrics();
+        std::cout << "Snapshot runs: " << metrics.runs_.load(std::memory_order_relaxed)
+            << ", last saved " << metrics.books_.load(std::memory_order_relaxed) << " books ("
+            << metrics.orders_.load(std::memory_order_relaxed) << " orders) in "
+            << metrics.durationUs_.load(std::memory_order_relaxed) << " us, longest matching pause "
+            << metrics.longestPauseUs_.load(std::memory_order_relaxed) << " us, worst since start "
+            << metrics.worstPauseUs_.load(std::memory_order_relaxed) << " us" << std::endl;
+    }
 
     std::cout << "Stopping server..." << std::endl;
     server.stop();
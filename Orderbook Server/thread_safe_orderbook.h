@@ -0,0 +1,120 @@
+#pragma once
+
+#include <mutex>
+#include <shared_mutex>
+
+#include "orderbook.cpp"
+#include "seqlock.h"
+
+// This adapter ensures thread safety for the orderbook: every call takes the book's lock on the caller's
+// thread. The server matches on BookManager's shard threads instead; OrderbookNetworkAdapter and the
+// mutex side of the engine benchmark still use this
+class ThreadSafeOrderbook {
+public:
+    ThreadSafeOrderbook() : orderbook_() {}
+
+    // Add an order with thread safety
+    Trades AddOrder(const Order& order) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        Trades trades = orderbook_.AddOrder(order);
+        top_.Store(orderbook_.GetTopOfBook());
+        return trades;
+    }
+
+    // Add an order, reporting each fill to sink while the lock is held
+    template <typename TradeSink>
+    void AddOrder(const Order& order, TradeSink&& sink) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        orderbook_.AddOrder(order, std::forward<TradeSink>(sink));
+        top_.Store(orderbook_.GetTopOfBook());
+    }
+
+    // Cancel an order with thread safety
+    void CancelOrder(OrderID orderId) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        orderbook_.CancelOrder(orderId);
+        top_.Store(orderbook_.GetTopOfBook());
+    }
+
+    // Modify an order with thread safety
+    Trades MatchOrder(OrderModify order) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        Trades trades = orderbook_.MatchOrder(order);
+        top_.Store(orderbook_.GetTopOfBook());
+        return trades;
+    }
+
+    // Modify an order, reporting each fill to sink while the lock is held
+    template <typename TradeSink>
+    void MatchOrder(OrderModify order, TradeSink&& sink) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        orderbook_.MatchOrder(order, std::forward<TradeSink>(sink));
+        top_.Store(orderbook_.GetTopOfBook());
+    }
+
+    // Expire every GoodForDay/GoodTillDate order due by now in one pass under the write lock
+    std::size_t ExpireOrders(Timestamp now) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        std::size_t expired = orderbook_.ExpireOrders(now);
+        top_.Store(orderbook_.GetTopOfBook());
+        return expired;
+    }
+
+    // Expire due orders, handing each one to sink while the lock is held
+    template <typename ExpirySink>
+    std::size_t ExpireOrders(Timestamp now, ExpirySink&& sink) {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        std::size_t expired = orderbook_.ExpireOrders(now, std::forward<ExpirySink>(sink));
+        top_.Store(orderbook_.GetTopOfBook());
+        return expired;
+    }
+
+    // Start an auction call phase: orders rest without matching until Uncross
+    void StartAuction() {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        orderbook_.StartAuction();
+    }
+
+    // Execute the auction at its clearing price and go back to continuous matching
+    Trades Uncross() {
+        std::unique_lock<std::shared_mutex> lock(mutex_);
+        Trades trades = orderbook_.Uncross();
+        top_.Store(orderbook_.GetTopOfBook());
+        return trades;
+    }
+
+    // Best levels as of the last mutation, read from the seqlock snapshot without touching mutex_
+    TopOfBook GetTopOfBook() const {
+        return top_.Load();
+    }
+
+    // Get orderbook information with thread safety (read-only operation)
+    OrderbookLevelInfos GetOrderInfos() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return orderbook_.GetOrderInfos();
+    }
+
+    // Get the best levels per side with thread safety (read-only operation)
+    OrderbookDepth GetDepth(std::size_t levels) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return orderbook_.GetDepth(levels);
+    }
+
+    // Visit the best levels per side under the read lock, e.g. to fill a network response in place
+    template <typename Visitor>
+    void GetDepth(std::size_t levels, Visitor&& visitor) const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        orderbook_.GetDepth(levels, std::forward<Visitor>(visitor));
+    }
+
+    // Get the size of the orderbook with thread safety (read-only operation)
+    std::size_t Size() const {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        return orderbook_.Size();
+    }
+
+private:
+    Orderbook orderbook_;
+    mutable std::shared_mutex mutex_; // Allows multiple readers but exclusive writers
+    SeqLock<TopOfBook> top_;          // Published by whoever holds the write lock
+};
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+#include "order_pool.h"
+
+// slot an entry is chained into, stored next to the timer links so Remove needs no search
+using TimerSlot = std::uint16_t;
+inline constexpr TimerSlot InvalidTimerSlot = std::numeric_limits<TimerSlot>::max();
+
+// Hierarchical timer wheel for order expiry. Only orders that can expire are stored,
+// chained through intrusive timer links in the pooled objects, so scheduling and
+// removal are O(1) and never allocate. Advancing time only touches slots that come
+// due, and it jumps straight over stretches where nothing can expire. Expirations
+// come out in bulk, one due slot at a time.
+//
+// Pool must hand out objects that provide GetExpiry(), Get/SetTimerPrev(),
+// Get/SetTimerNext() and Get/SetTimerSlot().
+template <typename Pool>
+class TimerWheel
+{
+public:
+    using Tick = std::uint64_t;
+    using Slot = TimerSlot;
+
+    static constexpr std::size_t Levels = 4;
+    static constexpr std::size_t SlotBits = 8;
+    static constexpr std::size_t SlotsPerLevel = std::size_t{ 1 } << SlotBits;
+    static constexpr Slot OverflowSlot = static_cast<Slot>(Levels * SlotsPerLevel);
+    static constexpr Slot InvalidSlot = InvalidTimerSlot;
+
+    explicit TimerWheel(Pool& pool)
+        : pool_{ pool }
+    {
+        heads_.fill(InvalidPoolHandle);
+    }
+
+    Tick Now() const { return now_; }
+    std::size_t Size() const { return size_; }
+
+    // expiry must be later than Now()
+    void Schedule(PoolHandle handle)
+    {
+        const auto slot = SlotFor(pool_[handle].GetExpiry());
+        Link(slot, handle);
+    }
+
+    void Remove(PoolHandle handle)
+    {
+        auto& entry = pool_[handle];
+        const auto slot = entry.GetTimerSlot();
+        if (slot == InvalidSlot)
+            return;
+
+        if (entry.GetTimerPrev() == InvalidPoolHandle)
+            heads_[slot] = entry.GetTimerNext();
+        else
+            pool_[entry.GetTimerPrev()].SetTimerNext(entry.GetTimerNext());
+
+        if (entry.GetTimerNext() != InvalidPoolHandle)
+            pool_[entry.GetTimerNext()].SetTimerPrev(entry.GetTimerPrev());
+
+        entry.SetTimerSlot(InvalidSlot);
+        --counts_[LevelOf(slot)];
+        --size_;
+    }
+
+    // moves time forward to now and calls expire(handle) for every entry whose expiry is <= now.
+    // entries are already unlinked from the wheel when expire sees them
+    template <typename Expire>
+    std::size_t Advance(Tick now, Expire&& expire)
+    {
+        std::size_t expired = 0;
+
+        while (now_ < now)
+        {
+            if (size_ == 0)
+            {
+                now_ = now;
+                break;
+            }
+
+            // nothing can come due before the next boundary of the lowest occupied level
+            const auto level = LowestOccupiedLevel();
+            if (level > 0)
+            {
+                const auto shift = level * SlotBits;
+                const Tick boundary = ((now_ >> shift) + 1) << shift;
+                if (boundary > now)
+                {
+                    now_ = now;
+                    break;
+                }
+
+                now_ = boundary - 1;
+            }
+
+            ++now_;
+            Cascade();
+            expired += ExpireSlot(static_cast<Slot>(now_ & (SlotsPerLevel - 1)), expire);
+        }
+
+        return expired;
+    }
+
+private:
+    // the overflow slot counts as one extra level above the wheel
+    static std::size_t LevelOf(Slot slot) { return slot / SlotsPerLevel; }
+
+    // the level is the highest byte in which expiry and now differ, so the entry is
+    // cascaded down exactly when time reaches expiry's prefix at that level
+    Slot SlotFor(Tick expiry) const
+    {
+        const auto diff = expiry ^ now_;
+        for (std::size_t level = 0; level < Levels; ++level)
+        {
+            if ((diff >> ((level + 1) * SlotBits)) == 0)
+                return static_cast<Slot>(level * SlotsPerLevel + ((expiry >> (level * SlotBits)) & (SlotsPerLevel - 1)));
+        }
+
+        return OverflowSlot;
+    }
+
+    std::size_t LowestOccupiedLevel() const
+    {
+        for (std::size_t level = 0; level < Levels; ++level)
+        {
+            if (counts_[level] != 0)
+                return level;
+        }
+
+        return Levels; // only the overflow slot is occupied
+    }
+
+    void Link(Slot slot, PoolHandle handle)
+    {
+        auto& entry = pool_[handle];
+        entry.SetTimerSlot(slot);
+        entry.SetTimerPrev(InvalidPoolHandle);
+        entry.SetTimerNext(heads_[slot]);
+
+        if (heads_[slot] != InvalidPoolHandle)
+            pool_[heads_[slot]].SetTimerPrev(handle);
+
+        heads_[slot] = handle;
+        ++counts_[LevelOf(slot)];
+        ++size_;
+    }
+
+    // detaches a whole slot and hands its chain back
+    PoolHandle Detach(Slot slot)
+    {
+        const auto head = heads_[slot];
+        heads_[slot] = InvalidPoolHandle;
+
+        for (auto handle = head; handle != InvalidPoolHandle; handle = pool_[handle].GetTimerNext())
+        {
+            pool_[handle].SetTimerSlot(InvalidSlot);
+            --counts_[LevelOf(slot)];
+            --size_;
+        }
+
+        return head;
+    }
+
+    // on a level boundary the matching slot of the level above is redistributed downwards,
+    // highest level first so entries can fall more than one level in the same tick
+    void Cascade()
+    {
+        if ((now_ & ((Tick{ 1 } << (Levels * SlotBits)) - 1)) == 0)
+            Reschedule(OverflowSlot);
+
+        for (auto level = Levels - 1; level > 0; --level)
+        {
+            const auto shift = level * SlotBits;
+            if ((now_ & ((Tick{ 1 } << shift) - 1)) != 0)
+                continue;
+
+            Reschedule(static_cast<Slot>(level * SlotsPerLevel + ((now_ >> shift) & (SlotsPerLevel - 1))));
+        }
+    }
+
+    void Reschedule(Slot slot)
+    {
+        for (auto handle = Detach(slot); handle != InvalidPoolHandle; )
+        {
+            const auto next = pool_[handle].GetTimerNext();
+            Link(SlotFor(pool_[handle].GetExpiry()), handle);
+            handle = next;
+        }
+    }
+
+    template <typename Expire>
+    std::size_t ExpireSlot(Slot slot, Expire& expire)
+    {
+        std::size_t expired = 0;
+        for (auto handle = Detach(slot); handle != InvalidPoolHandle; ++expired)
+        {
+            // read the link first, expire is free to release the entry
+            const auto next = pool_[handle].GetTimerNext();
+            expire(handle);
+            handle = next;
+        }
+
+        return expired;
+    }
+
+    Pool& pool_;
+    std::array<PoolHandle, Levels * SlotsPerLevel + 1> heads_;
+    std::array<std::size_t, Levels + 1> counts_{ };
+    std::size_t size_{ 0 };
+    Tick now_{ 0 };
+};